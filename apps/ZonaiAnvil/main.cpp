@@ -12,7 +12,7 @@
 #include "WindowSystem.hpp"
 #include "sml.hpp"
 
-int main() {
+int main(int argc, char** argv) {
   using namespace boost::sml::literals;
 
   Log::StateMachine::logging_level = sb::logger::Level::Debug;
@@ -28,20 +28,19 @@ int main() {
   SmlLogger smlLogger;
   AppSM sm{smlLogger};
 
-  CommunicationManager::Manager comms(ctx, sm);
+  CommunicationManager::Manager comms(ctx);
+  // Extra ports from the command line, e.g. unix:/run/dev0.sock or tcp:127.0.0.1:5000
+  for (int i = 1; i < argc; i++) comms.addPort(argv[i]);
   UIManager::ApplyTheme(ctx.visual.themeIndex);
   UIManager::ApplyFont(fontManager.getFont(FontManager::FontType::Default), 18);
 
-  // Initial port scan
-  ctx.connection.portPaths = comms.listPorts();
-  for (size_t i = 0; i < ctx.connection.portPaths.size(); ++i) {
-    strcat(ctx.connection.portList, ctx.connection.portPaths[i].c_str());
-    if (i < ctx.connection.portPaths.size() - 1) strcat(ctx.connection.portList, ";");
-  }
+  // Initial port list; the registry keeps it current after this
+  UIManager::UpdatePortList(ctx, comms.listPorts());
 
   while (!window.shouldClose()) {
+    if (comms.pollPorts()) UIManager::UpdatePortList(ctx, comms.listPorts());
     comms.update();
-    UIManager::UpdateStateLogic(ctx, sm);
+    UIManager::UpdateStateLogic(ctx, sm, comms);
     UIManager::HandleInput(ctx);
 
     shaderManager.updateUniforms((float)window.getWidth(), (float)window.getHeight());
@@ -51,6 +50,9 @@ int main() {
     UIManager::Draw(ctx, sm, comms);
     window.endTextureMode();
 
+    // Coalesce this frame's writes into a single transport write
+    comms.flush();
+
     // Final screen pass
     window.beginDrawing();
     if (ctx.visual.currentShader > 0) {
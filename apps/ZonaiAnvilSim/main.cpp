@@ -0,0 +1,695 @@
+// ZonaiAnvilSim: a simulated device on the slave side of a pseudo-terminal.
+//
+// The app connects to the printed /dev/pts/N path through the normal
+// LinuxSerialPort path, so the whole kernel tty stack (buffering, partial
+// reads, syscalls) sits between the two ends. With --listen the device is
+// served on a socket instead, for the app's SocketPort transport. With --drops
+// several devices share the link as a multi-drop bus.
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ICommunication.hpp"
+#include "Log.hpp"
+#include "ProtocolHandler.hpp"
+#include "SimulatedDevice.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile std::sig_atomic_t running = 1;
+
+void onSignal(int) { running = 0; }
+
+struct Options {
+  std::string schema = "ttyMock3";
+  std::size_t generatedParams = 0;
+  int latencyMs = 0;
+  std::size_t bytesPerSec = 0;  // 0 = unlimited
+  std::string link;
+  std::string listen;  // unix:<path> or tcp:<host>:<port>
+  uint16_t capabilities = Protocol::kAllCapabilities;
+  int lossPercent = 0;  // requests ignored at random, to exercise the app's retries
+  bool schemaHash = true;
+  std::size_t drops = 0;  // > 0: a bus of this many devices at addresses 1..drops
+  std::string blobDir;    // committed blobs are saved here
+};
+
+using Devices = std::vector<std::unique_ptr<SimulatedDevice>>;
+
+// Bytes per second a direction of the link may carry, 0 for no limit
+class TokenBucket {
+ public:
+  explicit TokenBucket(std::size_t bytesPerSec) : bytesPerSec(bytesPerSec), lastRefill(Clock::now()) {
+    // Allow a few milliseconds worth of burst so small packets are not split
+    burst = std::max<std::size_t>(64, bytesPerSec / 200);
+    tokens = static_cast<double>(burst);
+  }
+
+  // How many of `wanted` bytes may pass now
+  std::size_t allowed(std::size_t wanted) {
+    if (bytesPerSec == 0) return wanted;
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    tokens = std::min(static_cast<double>(burst), tokens + elapsed * static_cast<double>(bytesPerSec));
+    return std::min(wanted, static_cast<std::size_t>(tokens));
+  }
+  void consume(std::size_t bytes) {
+    if (bytesPerSec > 0) tokens -= static_cast<double>(bytes);
+  }
+
+ private:
+  std::size_t bytesPerSec;
+  std::size_t burst;
+  double tokens;
+  Clock::time_point lastRefill;
+};
+
+// Device end of the link: the PTY master or an accepted socket. Responses are
+// held back by the configured latency and then released through a token bucket;
+// requests are read through another, like the two directions of a UART.
+class DeviceLink : public ICommunication {
+ public:
+  DeviceLink(int fd, int latencyMs, std::size_t bytesPerSec)
+      : fd(fd), latency(std::chrono::milliseconds(latencyMs)), txBucket(bytesPerSec), rxBucket(bytesPerSec) {}
+
+  bool open(const std::string&, int) override { return fd >= 0; }
+  void close() override {}
+  bool isOpen() const override { return fd >= 0; }
+
+  std::size_t read(std::span<uint8_t> buffer) override {
+    std::size_t allowed = rxBucket.allowed(buffer.size());
+    rxThrottled = allowed == 0;
+    if (rxThrottled) return 0;
+    ssize_t n = ::read(fd, buffer.data(), allowed);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) peerGone = true;
+    if (n <= 0) return 0;
+    rxBucket.consume(static_cast<std::size_t>(n));
+    return static_cast<std::size_t>(n);
+  }
+
+  std::size_t write(std::span<const uint8_t> data) override {
+    if (data.empty()) return 0;
+    pending.push_back({Clock::now() + latency, std::vector<uint8_t>(data.begin(), data.end())});
+    return data.size();
+  }
+
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks) override {
+    // Keep one coalesced batch as one delayed unit
+    Pending batch{Clock::now() + latency, {}};
+    for (auto chunk : chunks) batch.data.insert(batch.data.end(), chunk.begin(), chunk.end());
+    std::size_t size = batch.data.size();
+    if (size > 0) pending.push_back(std::move(batch));
+    return size;
+  }
+
+  std::vector<std::string> listPorts() override { return {}; }
+
+  // Switches to a new peer (socket mode), dropping anything still queued for the old one
+  void reset(int newFd) {
+    fd = newFd;
+    peerGone = false;
+    pending.clear();
+    outbox.clear();
+  }
+  bool isPeerGone() const { return peerGone; }
+  int getFd() const { return fd; }
+
+  // Moves due bytes to the master fd, subject to the throughput limit
+  void pump() {
+    auto now = Clock::now();
+    while (!pending.empty() && pending.front().readyTime <= now) {
+      outbox.insert(outbox.end(), pending.front().data.begin(), pending.front().data.end());
+      pending.pop_front();
+    }
+    if (outbox.empty()) return;
+
+    std::size_t allowed = txBucket.allowed(outbox.size());
+    if (allowed == 0) return;
+    ssize_t n = ::send(fd, outbox.data(), allowed, MSG_NOSIGNAL);
+    if (n < 0 && errno == ENOTSOCK) n = ::write(fd, outbox.data(), allowed);
+    if (n <= 0) return;  // EAGAIN: the app is not reading, try again next tick
+    outbox.erase(outbox.begin(), outbox.begin() + n);
+    txBucket.consume(static_cast<std::size_t>(n));
+  }
+
+  // Events poll() should wait for: none while reading is throttled, or it would spin
+  short pollEvents() const { return rxThrottled ? 0 : POLLIN; }
+
+  // How long poll() may sleep before pump() has work to do
+  int nextDeadlineMs() const {
+    if (!outbox.empty() || rxThrottled) return 1;
+    if (pending.empty()) return 100;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(pending.front().readyTime - Clock::now());
+    return std::clamp<int>(static_cast<int>(wait.count()) + 1, 0, 100);
+  }
+
+ private:
+  struct Pending {
+    Clock::time_point readyTime;
+    std::vector<uint8_t> data;
+  };
+
+  int fd;
+  bool peerGone = false;
+  bool rxThrottled = false;  // the last read() found the bucket empty
+  Clock::duration latency;
+  TokenBucket txBucket;
+  TokenBucket rxBucket;
+  std::deque<Pending> pending;
+  std::vector<uint8_t> outbox;
+};
+
+uint8_t parseType(const std::string& field) {
+  if (field == "toggle") return static_cast<uint8_t>(Protocol::ParamType::kToggle);
+  if (field == "slider") return static_cast<uint8_t>(Protocol::ParamType::kSlider);
+  if (field == "numeric") return static_cast<uint8_t>(Protocol::ParamType::kNumeric);
+  if (field == "string") return static_cast<uint8_t>(Protocol::ParamType::kString);
+  return static_cast<uint8_t>(std::stoi(field));
+}
+
+// One parameter per line: id,type,name,min,max,value  (# starts a comment)
+bool loadSchemaCsv(const std::string& path, std::vector<SimulatedParam>& params) {
+  std::ifstream file(path);
+  if (!file) return false;
+
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(file, line)) {
+    lineNo++;
+    if (line.empty() || line[0] == '#') continue;
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    for (std::string field; std::getline(ss, field, ',');) fields.push_back(field);
+    if (fields.size() < 5) {
+      Log::Device::Error() << path << ":" << lineNo << ": expected id,type,name,min,max[,value]";
+      return false;
+    }
+    try {
+      SimulatedParam p{};
+      p.id = static_cast<uint16_t>(std::stoi(fields[0]));
+      p.type = parseType(fields[1]);
+      p.name = fields[2];
+      p.min = std::stof(fields[3]);
+      p.max = std::stof(fields[4]);
+      p.value = p.min;
+      if (fields.size() > 5) {
+        if (p.type == static_cast<uint8_t>(Protocol::ParamType::kString)) {
+          p.stringValue = fields[5];
+        } else {
+          p.value = std::stof(fields[5]);
+        }
+      }
+      params.push_back(std::move(p));
+    } catch (const std::exception&) {
+      Log::Device::Error() << path << ":" << lineNo << ": malformed field";
+      return false;
+    }
+  }
+  return true;
+}
+
+void printUsage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " [options]\n"
+            << "  --schema <ttyMock1|ttyMock2|ttyMock3|file.csv>  parameter set (default ttyMock3)\n"
+            << "  --params <N>          generate N synthetic parameters instead (max 65535;\n"
+            << "                        ids above 255 need --paged on)\n"
+            << "  --latency-ms <ms>     delay before each response leaves the device\n"
+            << "  --bytes-per-sec <n>   throttle throughput each way, like a UART (0 = unlimited)\n"
+            << "  --link <path>         also expose the slave tty as a symlink at <path>\n"
+            << "  --listen <uri>        serve on unix:<path> or tcp:<host>:<port> instead of a PTY\n"
+            << "  --integrity <mode>    strongest check offered: xor, crc16 or crc32c (default)\n"
+            << "  --framing <mode>      framing offered: start (start byte only) or cobs (default)\n"
+            << "  --sequence <on|off>   offer sequence ids in the header (default on)\n"
+            << "  --read-changes <on|off>\n"
+            << "                        answer delta reads (CMD_READ_CHANGES, default on)\n"
+            << "  --telemetry <on|off>  accept subscriptions and push values (default on)\n"
+            << "  --compression <on|off>\n"
+            << "                        compress large responses (default on)\n"
+            << "  --write-all <on|off>  accept batched WRITE_ALL transactions (default on)\n"
+            << "  --log-tokens <on|off> send logs as format ids and arguments, filtered by the\n"
+            << "                        host's log level (default on)\n"
+            << "  --paged <on|off>      serve schema and values in pages, and 16-bit ids (default on)\n"
+            << "                        (xor, start and off everywhere make a legacy device)\n"
+            << "  --schema-hash <on|off>\n"
+            << "                        report the schema hash in the PING answer (default on)\n"
+            << "  --loss <percent>      ignore this share of requests, as if they were lost\n"
+            << "  --drops <N>           serve N devices on one addressed bus, at addresses 1..N\n"
+            << "                        (fixed CRC-32C, COBS and sequence ids; no telemetry)\n"
+            << "  --blob <on|off>       accept blob transfers (default on)\n"
+            << "  --blob-dir <dir>      save each committed blob as <dir>/slot<N>.bin\n"
+            << "                        (drop<A>-slot<N>.bin on a bus)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") return false;
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--schema") {
+      opts.schema = value;
+    } else if (arg == "--params") {
+      opts.generatedParams = std::min<std::size_t>(std::strtoul(value.c_str(), nullptr, 10), 65535);
+    } else if (arg == "--latency-ms") {
+      opts.latencyMs = std::max(0, std::atoi(value.c_str()));
+    } else if (arg == "--bytes-per-sec") {
+      opts.bytesPerSec = std::strtoul(value.c_str(), nullptr, 10);
+    } else if (arg == "--link") {
+      opts.link = value;
+    } else if (arg == "--listen") {
+      opts.listen = value;
+    } else if (arg == "--integrity") {
+      opts.capabilities &= ~(Protocol::kCapCrc16 | Protocol::kCapCrc32c);
+      if (value == "crc16") {
+        opts.capabilities |= Protocol::kCapCrc16;
+      } else if (value == "crc32c") {
+        opts.capabilities |= Protocol::kCapCrc16 | Protocol::kCapCrc32c;
+      } else if (value != "xor") {
+        std::cerr << "Unknown integrity mode " << value << "\n";
+        return false;
+      }
+    } else if (arg == "--framing") {
+      if (value == "cobs") {
+        opts.capabilities |= Protocol::kCapCobs;
+      } else if (value == "start") {
+        opts.capabilities &= ~Protocol::kCapCobs;
+      } else {
+        std::cerr << "Unknown framing mode " << value << "\n";
+        return false;
+      }
+    } else if (arg == "--sequence") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapSequence;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapSequence;
+      } else {
+        std::cerr << "Expected on or off for --sequence\n";
+        return false;
+      }
+    } else if (arg == "--read-changes") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapReadChanges;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapReadChanges;
+      } else {
+        std::cerr << "Expected on or off for --read-changes\n";
+        return false;
+      }
+    } else if (arg == "--telemetry") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapTelemetry;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapTelemetry;
+      } else {
+        std::cerr << "Expected on or off for --telemetry\n";
+        return false;
+      }
+    } else if (arg == "--compression") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapCompression;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapCompression;
+      } else {
+        std::cerr << "Expected on or off for --compression\n";
+        return false;
+      }
+    } else if (arg == "--write-all") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapWriteAll;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapWriteAll;
+      } else {
+        std::cerr << "Expected on or off for --write-all\n";
+        return false;
+      }
+    } else if (arg == "--paged") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapPaged;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapPaged;
+      } else {
+        std::cerr << "Expected on or off for --paged\n";
+        return false;
+      }
+    } else if (arg == "--log-tokens") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapLogTokens;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapLogTokens;
+      } else {
+        std::cerr << "Expected on or off for --log-tokens\n";
+        return false;
+      }
+    } else if (arg == "--schema-hash") {
+      if (value != "on" && value != "off") {
+        std::cerr << "Expected on or off for --schema-hash\n";
+        return false;
+      }
+      opts.schemaHash = value == "on";
+    } else if (arg == "--loss") {
+      opts.lossPercent = std::clamp(std::atoi(value.c_str()), 0, 100);
+    } else if (arg == "--blob") {
+      if (value == "on") {
+        opts.capabilities |= Protocol::kCapBlob;
+      } else if (value == "off") {
+        opts.capabilities &= ~Protocol::kCapBlob;
+      } else {
+        std::cerr << "Expected on or off for --blob\n";
+        return false;
+      }
+    } else if (arg == "--blob-dir") {
+      opts.blobDir = value;
+    } else if (arg == "--drops") {
+      opts.drops = std::min<std::size_t>(std::strtoul(value.c_str(), nullptr, 10), 255);
+    } else {
+      std::cerr << "Unknown option " << arg << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Raw mode on the slave so the line discipline does not echo or translate our bytes
+bool makeRaw(int fd) {
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) != 0) return false;
+  tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  tio.c_cflag &= ~(CSIZE | PARENB);
+  tio.c_cflag |= CS8;
+  return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+// Listening socket for --listen; returns -1 (after reporting why) on failure
+int listenOn(const std::string& uri) {
+  int s = -1;
+  if (uri.rfind("unix:", 0) == 0) {
+    std::string path = uri.substr(5);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+      std::cerr << "Invalid Unix socket path: " << path << "\n";
+      return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    ::unlink(path.c_str());
+    s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s >= 0 && ::bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      ::close(s);
+      s = -1;
+    }
+  } else if (uri.rfind("tcp:", 0) == 0) {
+    std::string hostPort = uri.substr(4);
+    std::size_t colon = hostPort.rfind(':');
+    if (colon == std::string::npos) {
+      std::cerr << "Expected tcp:<host>:<port>\n";
+      return -1;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(hostPort.substr(0, colon).c_str(), hostPort.substr(colon + 1).c_str(), &hints, &results) != 0) {
+      std::cerr << "Cannot resolve " << hostPort << "\n";
+      return -1;
+    }
+    for (addrinfo* ai = results; ai && s < 0; ai = ai->ai_next) {
+      s = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+      if (s < 0) continue;
+      int one = 1;
+      setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if (::bind(s, ai->ai_addr, ai->ai_addrlen) != 0) {
+        ::close(s);
+        s = -1;
+      }
+    }
+    freeaddrinfo(results);
+  } else {
+    std::cerr << "--listen expects unix:<path> or tcp:<host>:<port>\n";
+    return -1;
+  }
+
+  if (s < 0 || ::listen(s, 1) != 0) {
+    std::cerr << "Cannot listen on " << uri << ": " << std::strerror(errno) << "\n";
+    if (s >= 0) ::close(s);
+    return -1;
+  }
+  return s;
+}
+
+void logStart(const Options& opts, const Devices& devices, const std::string& where) {
+  Log::Device::Info() << "Simulating " << devices.front()->getParams().size() << " parameters on " << where
+                      << (opts.drops ? " (bus of " + std::to_string(opts.drops) + " devices)" : "") << ", latency "
+                      << opts.latencyMs << " ms, "
+                      << (opts.bytesPerSec ? std::to_string(opts.bytesPerSec) + " B/s" : "unthrottled");
+}
+
+// One device, or a bus of opts.drops devices with the same parameters
+Devices makeDevices(const Options& opts, const std::vector<SimulatedParam>& params, const std::string& name) {
+  Devices devices;
+  for (std::size_t i = 0; i < std::max<std::size_t>(opts.drops, 1); i++) {
+    auto& device = *devices.emplace_back(
+        std::make_unique<SimulatedDevice>(opts.drops ? name + "@" + std::to_string(i + 1) : name));
+    device.setParams(params);
+    // Pushed telemetry would collide with other devices' answers on a bus
+    device.setCapabilities(opts.drops ? opts.capabilities & ~Protocol::kCapTelemetry : opts.capabilities);
+    device.setReportSchemaHash(opts.schemaHash);
+    if (!opts.blobDir.empty()) {
+      std::string prefix = opts.blobDir + "/" + (opts.drops ? "drop" + std::to_string(i + 1) + "-" : "");
+      device.onBlob = [prefix](uint8_t slot, std::span<const uint8_t> blob) {
+        std::string path = prefix + "slot" + std::to_string(slot) + ".bin";
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!out) Log::Device::Error() << "Cannot write " << path;
+      };
+    }
+  }
+  return devices;
+}
+
+// Slave-role visitor for ProtocolHandler::update(): every request goes to the device
+// it is addressed to, and everything sent while answering carries the request's
+// sequence id (and, on a bus, the device's address)
+struct DeviceRequests {
+  ProtocolHandler& handler;
+  Devices& devices;
+  int lossPercent = 0;
+
+  void onRequest(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence, uint8_t address) {
+    static std::minstd_rand rng(std::random_device{}());
+    SimulatedDevice* device = deviceAt(address);
+    if (!device) return;  // addressed to no device of ours; a bus device stays silent
+    if (cmd != Protocol::Command::kPing && static_cast<int>(rng() % 100) < lossPercent) {
+      Log::Device::Warning() << "Dropping command 0x" << std::hex << static_cast<int>(cmd) << " (simulated loss)";
+      return;
+    }
+    device->handleCommand(cmd, payload, [this, sequence, address](Protocol::Command c, std::span<const uint8_t> p) {
+      handler.sendPacket(c, p, sequence, address);
+    });
+  }
+
+  SimulatedDevice* deviceAt(uint8_t address) {
+    if (!handler.getLinkConfig().addressed) return devices.front().get();
+    if (address == 0 || address > devices.size()) return nullptr;
+    return devices[address - 1].get();
+  }
+
+  // Telemetry the devices have due; pushed unsolicited, so without a sequence id
+  void pushTelemetry() {
+    for (std::size_t i = 0; i < devices.size(); i++) {
+      auto address = static_cast<uint8_t>(handler.getLinkConfig().addressed ? i + 1 : 0);
+      devices[i]->poll(SimulatedDevice::Clock::now(), [this, address](Protocol::Command c, std::span<const uint8_t> p) {
+        handler.sendPacket(c, p, 0, address);
+      });
+    }
+    handler.flush();
+  }
+};
+
+// Poll timeout covering both the link's pending output and the devices' next samples
+int pollTimeoutMs(const DeviceLink& link, const Devices& devices) {
+  int timeout = link.nextDeadlineMs();
+  for (const auto& device : devices) {
+    auto deadline = device->nextDeadline();
+    if (deadline == SimulatedDevice::Clock::time_point::max()) continue;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - SimulatedDevice::Clock::now());
+    timeout = std::clamp<int>(static_cast<int>(wait.count()), 0, timeout);
+  }
+  return timeout;
+}
+
+// A single device switches framing when it negotiates; a bus keeps its fixed modes
+void attachDevices(ProtocolHandler& handler, Devices& devices, bool bus) {
+  if (bus) {
+    handler.setLinkConfig(Protocol::BusLinkConfig());
+    return;
+  }
+  devices.front()->onLinkConfig = [&handler](const Protocol::LinkConfig& config) {
+    handler.setLinkConfig(config);
+    Log::Device::Info() << "Link integrity: " << Protocol::IntegrityName(config.integrity)
+                        << ", framing: " << Protocol::FramingName(config.framing)
+                        << (config.sequenced ? ", sequenced" : "")
+                        << (config.supports(Protocol::kCapCompression) ? ", compressed" : "");
+  };
+}
+
+int servePty(Options& opts, const std::vector<SimulatedParam>& params) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    std::cerr << "Failed to allocate a pseudo-terminal: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  std::string slavePath = ptsname(master);
+
+  // Holding our own slave fd keeps the master readable across app reconnects
+  // (otherwise the master reports EIO whenever the last slave fd closes)
+  int slave = ::open(slavePath.c_str(), O_RDWR | O_NOCTTY);
+  if (slave < 0 || !makeRaw(slave)) {
+    std::cerr << "Failed to configure " << slavePath << ": " << std::strerror(errno) << "\n";
+    ::close(master);
+    return 1;
+  }
+
+  if (!opts.link.empty()) {
+    ::unlink(opts.link.c_str());
+    if (::symlink(slavePath.c_str(), opts.link.c_str()) != 0) {
+      std::cerr << "Failed to create link " << opts.link << ": " << std::strerror(errno) << "\n";
+      opts.link.clear();
+    }
+  }
+
+  Devices devices = makeDevices(opts, params, slavePath);
+
+  DeviceLink link(master, opts.latencyMs, opts.bytesPerSec);
+  ProtocolHandler handler(&link);
+  attachDevices(handler, devices, opts.drops > 0);
+  DeviceRequests requests{handler, devices, opts.lossPercent};
+
+  // Printed on stdout alone so scripts can capture it
+  std::cout << slavePath << std::endl;
+  logStart(opts, devices, opts.link.empty() ? slavePath : slavePath + " (linked as " + opts.link + ")");
+
+  while (running) {
+    pollfd pfd{master, link.pollEvents(), 0};
+    int ready = ::poll(&pfd, 1, pollTimeoutMs(link, devices));
+    if (ready < 0 && errno != EINTR) break;
+
+    handler.update(requests);  // parses requests, answers through the link
+    requests.pushTelemetry();
+    link.pump();
+  }
+
+  if (!opts.link.empty()) ::unlink(opts.link.c_str());
+  ::close(slave);
+  ::close(master);
+  return 0;
+}
+
+// One client at a time; when it disconnects the next one is accepted
+int serveSocket(const Options& opts, const std::vector<SimulatedParam>& params) {
+  int listener = listenOn(opts.listen);
+  if (listener < 0) return 1;
+
+  Devices devices = makeDevices(opts, params, opts.listen);
+
+  DeviceLink link(-1, opts.latencyMs, opts.bytesPerSec);
+  std::unique_ptr<ProtocolHandler> handler;
+
+  std::cout << opts.listen << std::endl;
+  logStart(opts, devices, opts.listen);
+
+  int client = -1;
+  while (running) {
+    pollfd pfd{client >= 0 ? client : listener, client >= 0 ? link.pollEvents() : short{POLLIN}, 0};
+    int ready = ::poll(&pfd, 1, client >= 0 ? pollTimeoutMs(link, devices) : 100);
+    if (ready < 0 && errno != EINTR) break;
+
+    if (client < 0) {
+      if (ready <= 0) continue;
+      client = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (client < 0) continue;
+      int one = 1;
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on Unix sockets
+      link.reset(client);
+      handler = std::make_unique<ProtocolHandler>(&link);  // fresh parser state and legacy framing per client
+      attachDevices(*handler, devices, opts.drops > 0);
+      Log::Device::Info() << "Client connected";
+    }
+
+    DeviceRequests requests{*handler, devices, opts.lossPercent};
+    handler->update(requests);
+    requests.pushTelemetry();
+    link.pump();
+
+    if (link.isPeerGone()) {
+      Log::Device::Info() << "Client disconnected";
+      for (auto& device : devices) device->cancelSubscriptions();
+      handler.reset();
+      link.reset(-1);
+      ::close(client);
+      client = -1;
+    }
+  }
+
+  if (client >= 0) ::close(client);
+  ::close(listener);
+  if (opts.listen.rfind("unix:", 0) == 0) ::unlink(opts.listen.substr(5).c_str());
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opts;
+  if (!parseArgs(argc, argv, opts)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<SimulatedParam> params;
+  if (opts.generatedParams > 0) {
+    params = SimulatedDevice::generate(opts.generatedParams);
+  } else {
+    params = SimulatedDevice::preset(opts.schema);
+    if (params.empty() && !loadSchemaCsv(opts.schema, params)) {
+      std::cerr << "Unknown schema preset or unreadable file: " << opts.schema << "\n";
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  if (!opts.listen.empty()) return serveSocket(opts, params);
+  return servePty(opts, params);
+}
@@ -0,0 +1,514 @@
+// ZonaiBench: microbenchmarks for the protocol and transport hot paths.
+//
+// Every case repeats its operation until a round takes at least --min-time-ms,
+// then reports time per operation, throughput and heap allocations per
+// operation (counted by the global operator new below). --json writes the same
+// numbers as a baseline to diff against the next release:
+//
+//   ./build/zonai_bench --json baseline.json
+//   ./build/zonai_bench --filter parse.noisy
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Crc.hpp"
+#include "DeviceParameter.hpp"
+#include "ICommunication.hpp"
+#include "Log.hpp"
+#include "MockSerialPort.hpp"
+#include "ProtocolHandler.hpp"
+#include "ProtocolMessages.hpp"
+#include "SimulatedDevice.hpp"
+#include "TxQueue.hpp"
+
+namespace {
+
+uint64_t allocations = 0;  // the benchmarks run on one thread
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+namespace Wire = Protocol::Wire;
+
+struct Options {
+  std::string filter;  // substring of the case names to run
+  std::string jsonPath;
+  int minTimeMs = 200;
+};
+
+struct Result {
+  std::string name;
+  double nsPerOp = 0.0;
+  double bytesPerSec = 0.0;  // 0 when the case moves no payload
+  double allocsPerOp = 0.0;
+  uint64_t ops = 0;
+};
+
+// Keeps results the compiler could otherwise prove unused
+volatile uint64_t sink = 0;
+
+class Suite {
+ public:
+  explicit Suite(const Options& opts) : opts(opts) {}
+
+  bool wants(const std::string& name) const { return name.find(opts.filter) != std::string::npos; }
+
+  // Times `body`, one call of which performs `opsPerCall` operations over
+  // `bytesPerCall` bytes, in growing rounds until a round lasts --min-time-ms
+  template <typename Body>
+  void run(const std::string& name, uint64_t opsPerCall, uint64_t bytesPerCall, Body&& body) {
+    if (!wants(name)) return;
+    const auto minTime = std::chrono::milliseconds(opts.minTimeMs);
+    body();  // warm-up: caches, lazily grown buffers, first-time allocations
+
+    uint64_t calls = 1;
+    while (true) {
+      uint64_t allocsBefore = allocations;
+      auto start = Clock::now();
+      for (uint64_t i = 0; i < calls; i++) body();
+      auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+      uint64_t allocs = allocations - allocsBefore;
+
+      if (elapsed >= std::chrono::duration<double, std::nano>(minTime).count()) {
+        Result& r = results.emplace_back();
+        r.name = name;
+        r.ops = calls * opsPerCall;
+        r.nsPerOp = elapsed / static_cast<double>(r.ops);
+        r.bytesPerSec = static_cast<double>(calls * bytesPerCall) * 1e9 / elapsed;
+        r.allocsPerOp = static_cast<double>(allocs) / static_cast<double>(r.ops);
+        print(r);
+        return;
+      }
+      // Aim a little past the target; grow tenfold while rounds are too short to time
+      double target = std::chrono::duration<double, std::nano>(minTime).count() * 1.2;
+      calls = elapsed < 1e6 ? calls * 10 : static_cast<uint64_t>(static_cast<double>(calls) * target / elapsed) + 1;
+    }
+  }
+
+  void printHeader() const {
+    std::cout << std::left << std::setw(36) << "case" << std::right << std::setw(12) << "ns/op" << std::setw(12)
+              << "MB/s" << std::setw(12) << "allocs/op" << "\n";
+  }
+
+  bool writeJson(std::ostream& out) const {
+    out << "{\n  \"crc32c\": \"" << Crc::Crc32cImplementation() << "\",\n  \"min_time_ms\": " << opts.minTimeMs
+        << ",\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.nsPerOp
+          << ", \"bytes_per_sec\": " << r.bytesPerSec << ", \"allocs_per_op\": " << r.allocsPerOp
+          << ", \"ops\": " << r.ops << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+  }
+
+ private:
+  static void print(const Result& r) {
+    std::cout << std::left << std::setw(36) << r.name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << r.nsPerOp << std::setw(12) << r.bytesPerSec / 1e6 << std::setprecision(2)
+              << std::setw(12) << r.allocsPerOp << std::endl;
+  }
+
+  const Options& opts;
+  std::vector<Result> results;
+};
+
+// --- Transports ---
+
+// Always open; keeps what is written to it when `keep` is set, drops it otherwise
+class SinkPort : public ICommunication {
+ public:
+  explicit SinkPort(bool keep) : keep(keep) {}
+
+  bool open(const std::string&, int) override { return true; }
+  void close() override {}
+  bool isOpen() const override { return true; }
+  std::size_t read(std::span<uint8_t>) override { return 0; }
+  std::size_t write(std::span<const uint8_t> data) override {
+    if (keep) bytes.insert(bytes.end(), data.begin(), data.end());
+    return data.size();
+  }
+  std::vector<std::string> listPorts() override { return {}; }
+
+  std::vector<uint8_t> bytes;
+
+ private:
+  bool keep;
+};
+
+// Serves a prebuilt stream in reads of the given sizes (cycled), then nothing
+// until rewound
+class StreamPort : public ICommunication {
+ public:
+  StreamPort(std::vector<uint8_t> bytes, std::vector<std::size_t> chunks)
+      : bytes(std::move(bytes)), chunks(std::move(chunks)) {}
+
+  bool open(const std::string&, int) override { return true; }
+  void close() override {}
+  bool isOpen() const override { return true; }
+  std::size_t read(std::span<uint8_t> buffer) override {
+    std::size_t n = std::min({buffer.size(), chunks[chunk], bytes.size() - offset});
+    std::memcpy(buffer.data(), bytes.data() + offset, n);
+    offset += n;
+    chunk = (chunk + 1) % chunks.size();
+    return n;
+  }
+  std::size_t write(std::span<const uint8_t> data) override { return data.size(); }
+  std::vector<std::string> listPorts() override { return {}; }
+
+  void rewind() {
+    offset = 0;
+    chunk = 0;
+  }
+  std::size_t size() const { return bytes.size(); }
+
+ private:
+  std::vector<uint8_t> bytes;
+  std::vector<std::size_t> chunks;
+  std::size_t offset = 0;
+  std::size_t chunk = 0;
+};
+
+// Sends stderr to /dev/null while alive: corrupt frames in the noisy streams are
+// logged as errors, which is part of their cost but would flood the terminal
+class QuietStderr {
+ public:
+  QuietStderr() : saved(::dup(STDERR_FILENO)) {
+    int null = ::open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+      ::dup2(null, STDERR_FILENO);
+      ::close(null);
+    }
+  }
+  ~QuietStderr() {
+    if (saved < 0) return;
+    ::dup2(saved, STDERR_FILENO);
+    ::close(saved);
+  }
+
+ private:
+  int saved;
+};
+
+// --- Payloads ---
+
+std::vector<uint8_t> valueList(std::size_t count) {
+  std::vector<uint8_t> payload;
+  Wire::Count::append(payload, static_cast<uint8_t>(count));
+  for (std::size_t i = 0; i < count; i++) Wire::NumericValue::append(payload, static_cast<uint8_t>(i), i * 0.5f);
+  return payload;
+}
+
+std::vector<uint8_t> telemetryBatch(std::size_t samples) {
+  std::vector<uint8_t> payload;
+  Wire::TelemetryHeader::append(payload, 123456u);
+  Wire::Count::append(payload, static_cast<uint8_t>(samples));
+  for (std::size_t i = 0; i < samples; i++) Wire::NumericValue::append(payload, static_cast<uint8_t>(i % 4), 1.0f);
+  return payload;
+}
+
+// GET_SCHEMA responses for `params` generated parameters, 255 to a packet
+std::vector<std::vector<uint8_t>> schemaPages(std::size_t params) {
+  std::vector<std::vector<uint8_t>> pages;
+  auto generated = SimulatedDevice::generate(params);
+  for (std::size_t first = 0; first < generated.size(); first += 255) {
+    std::size_t count = std::min<std::size_t>(255, generated.size() - first);
+    auto& page = pages.emplace_back();
+    Wire::Count::append(page, static_cast<uint8_t>(count));
+    for (std::size_t i = first; i < first + count; i++) {
+      const auto& p = generated[i];
+      Wire::SchemaEntry::append(page, p.id, p.type, p.name, p.min, p.max);
+    }
+  }
+  return pages;
+}
+
+// --- Parse throughput ---
+
+enum class Noise { kNone, kLineNoise };
+
+struct Link {
+  const char* name;
+  Protocol::LinkConfig config;
+};
+
+const Link kLinks[] = {
+    {"xor", {}},
+    {"crc16", {Protocol::Integrity::kCrc16, Protocol::Framing::kStartByte, false, 0}},
+    {"cobs_crc32c", {Protocol::Integrity::kCrc32c, Protocol::Framing::kCobs, false, 0}},
+};
+
+// What a connected device sends: value lists, write acks, telemetry and logs.
+// With line noise, 1 packet in 8 is preceded by a burst of random bytes and
+// 1 in 32 has a bit flipped.
+std::vector<uint8_t> deviceTraffic(const Protocol::LinkConfig& link, std::size_t packets, Noise noise) {
+  const auto values = valueList(32);
+  const auto telemetry = telemetryBatch(40);
+  const std::string logLine = "\x01motor controller ready";
+  uint8_t ack[Wire::ParamId::kSize];
+  Wire::ParamId::encode(ack, 7);
+
+  SinkPort stream(true);
+  TxQueue tx(&stream);
+  tx.setLinkConfig(link);
+  std::mt19937 rng(12345);
+  for (std::size_t i = 0; i < packets; i++) {
+    if (noise == Noise::kLineNoise && rng() % 8 == 0) {
+      for (std::size_t n = 1 + rng() % 16; n > 0; n--) stream.bytes.push_back(static_cast<uint8_t>(rng()));
+    }
+    std::size_t start = stream.bytes.size();
+    switch (i % 4) {
+      case 0:
+        tx.enqueue(Protocol::Command::kReadAll, values);
+        break;
+      case 1:
+        tx.enqueue(Protocol::Command::kWriteValue, ack);
+        break;
+      case 2:
+        tx.enqueue(Protocol::Command::kTelemetry, telemetry);
+        break;
+      default:
+        tx.enqueue(Protocol::Command::kLog, {reinterpret_cast<const uint8_t*>(logLine.data()), logLine.size()});
+        break;
+    }
+    tx.flush();
+    if (noise == Noise::kLineNoise && rng() % 32 == 0) {
+      std::size_t at = start + rng() % (stream.bytes.size() - start);
+      stream.bytes[at] ^= static_cast<uint8_t>(1u << (rng() % 8));
+    }
+  }
+  return std::move(stream.bytes);
+}
+
+struct TrafficCounter {
+  uint64_t packets = 0;
+  float sum = 0.0f;
+
+  void onValues(Protocol::ValueListView values) {
+    packets++;
+    for (const auto& v : values) sum += v.value;
+  }
+  void onWriteAck(uint16_t id) {
+    packets++;
+    sum += id;
+  }
+  void onTelemetry(uint32_t, Protocol::ValueListView samples) {
+    packets++;
+    for (const auto& s : samples) sum += s.value;
+  }
+  void onLog(uint8_t level, std::string_view message) {
+    packets++;
+    sum += level + static_cast<float>(message.size());
+  }
+};
+
+void benchParse(Suite& suite) {
+  constexpr std::size_t kPackets = 256;
+  std::vector<std::size_t> fragments(64);
+  std::mt19937 rng(777);
+  for (auto& size : fragments) size = 1 + rng() % 13;
+
+  struct Stream {
+    const char* kind;
+    Noise noise;
+    std::vector<std::size_t> reads;
+  };
+  const Stream streams[] = {
+      {"clean", Noise::kNone, {4096}},
+      {"fragmented", Noise::kNone, fragments},
+      {"noisy", Noise::kLineNoise, {4096}},
+  };
+
+  for (const auto& s : streams) {
+    for (const auto& link : kLinks) {
+      std::string name = std::string("parse.") + s.kind + "." + link.name;
+      if (!suite.wants(name)) continue;
+      StreamPort port(deviceTraffic(link.config, kPackets, s.noise), s.reads);
+      ProtocolHandler handler(&port);
+      handler.setLinkConfig(link.config);
+      TrafficCounter counter;
+      {
+        QuietStderr quiet;
+        suite.run(name, kPackets, port.size(), [&] {
+          port.rewind();
+          handler.update(counter);
+        });
+      }
+      if (s.noise == Noise::kNone && counter.packets % kPackets != 0) {
+        std::cerr << name << ": delivered " << counter.packets << " packets, not a multiple of " << kPackets << "\n";
+      }
+      sink = sink + counter.packets + static_cast<uint64_t>(counter.sum);
+    }
+  }
+}
+
+// --- Encoding ---
+
+void benchEncode(Suite& suite) {
+  const auto values = valueList(32);
+  const auto schema = schemaPages(64).front();
+
+  for (const auto& link : kLinks) {
+    SinkPort port(false);
+    ProtocolHandler handler(&port);
+    handler.setLinkConfig(link.config);
+    suite.run(std::string("encode.values32.") + link.name, 1, values.size(),
+              [&] { handler.sendPacket(Protocol::Command::kReadAll, values); });
+  }
+
+  // Large payloads on a compressing link go through the Lz encoder first
+  for (uint16_t caps : {uint16_t{0}, Protocol::kCapCompression}) {
+    SinkPort port(false);
+    ProtocolHandler handler(&port);
+    handler.setLinkConfig({Protocol::Integrity::kCrc32c, Protocol::Framing::kCobs, false, caps});
+    suite.run(caps ? "encode.schema64.cobs_crc32c_lz" : "encode.schema64.cobs_crc32c", 1, schema.size(),
+              [&] { handler.sendPacket(Protocol::Command::kGetSchema, schema); });
+  }
+
+  std::vector<uint8_t> block(1024);
+  std::mt19937 rng(99);
+  for (auto& b : block) b = static_cast<uint8_t>(rng());
+  suite.run("checksum.xor.1k", 1, block.size(), [&] { sink = sink + Protocol::CalculateChecksum(block); });
+  suite.run("checksum.crc16.1k", 1, block.size(), [&] { sink = sink + Crc::Crc16Ccitt(block); });
+  suite.run("checksum.crc32c.1k", 1, block.size(), [&] { sink = sink + Crc::Crc32c(block); });
+}
+
+// --- Schema decode ---
+
+// Same work as the app's onSchema, appending across pages
+void decodeSchema(const std::vector<std::vector<uint8_t>>& pages, std::vector<DeviceParameter>& config) {
+  config.clear();
+  for (const auto& page : pages) {
+    Protocol::SchemaView schema(page);
+    config.reserve(config.size() + schema.declaredCount());
+    for (const auto& entry : schema) {
+      DeviceParameter& p = config.emplace_back();
+      p.id = entry.id;
+      p.type = entry.type;
+      p.name = entry.name;
+      p.min = entry.min;
+      p.max = entry.max;
+      p.value = p.min;
+      p.lastSentValue = p.value;
+      p.lastSentString = p.stringValue;
+    }
+  }
+}
+
+void benchSchema(Suite& suite) {
+  for (std::size_t params : {10, 1000, 10000}) {
+    auto pages = schemaPages(params);
+    std::size_t bytes = 0;
+    for (const auto& page : pages) bytes += page.size();
+    std::vector<DeviceParameter> config;
+    suite.run("schema.decode." + std::to_string(params), 1, bytes, [&] {
+      decodeSchema(pages, config);
+      sink = sink + config.size();
+    });
+  }
+}
+
+// --- Mock transport ---
+
+struct RoundTrip {
+  uint64_t answers = 0;
+  void onValues(Protocol::ValueListView) { answers++; }
+  void onWriteAck(uint16_t) { answers++; }
+};
+
+void benchMock(Suite& suite) {
+  MockSerialPort port;
+  port.open("ttyMock1", 115200);
+  port.setResponseDelay(std::chrono::milliseconds(0));
+  ProtocolHandler handler(&port);
+  RoundTrip visitor;
+
+  // Request, then poll until the answer is dispatched
+  auto roundTrip = [&](auto request) {
+    uint64_t before = visitor.answers;
+    request();
+    while (visitor.answers == before) handler.update(visitor);
+  };
+  suite.run("mock.roundtrip.write_value", 1, 0, [&] { roundTrip([&] { handler.writeValue(1, 42.0f); }); });
+  suite.run("mock.roundtrip.read_all", 1, 0, [&] { roundTrip([&] { handler.requestAllValues(); }); });
+}
+
+void printUsage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " [options]\n"
+            << "  --filter <text>       only run cases whose name contains <text>\n"
+            << "  --min-time-ms <ms>    shortest timed round per case (default 200)\n"
+            << "  --json <path>         also write the results to <path> as JSON\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") return false;
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--filter") {
+      opts.filter = value;
+    } else if (arg == "--min-time-ms") {
+      opts.minTimeMs = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--json") {
+      opts.jsonPath = value;
+    } else {
+      std::cerr << "Unknown option " << arg << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opts;
+  if (!parseArgs(argc, argv, opts)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  Log::Protocol::logging_level = sb::logger::Level::Warning;
+  Log::SerialMock::logging_level = sb::logger::Level::Warning;
+  Log::Device::logging_level = sb::logger::Level::Warning;
+
+  Suite suite(opts);
+  suite.printHeader();
+  benchParse(suite);
+  benchEncode(suite);
+  benchSchema(suite);
+  benchMock(suite);
+
+  if (opts.jsonPath.empty()) return 0;
+  std::ofstream out(opts.jsonPath);
+  if (!out || !suite.writeJson(out)) {
+    std::cerr << "Cannot write " << opts.jsonPath << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -65,15 +65,27 @@ struct CloseConnection {
   void operator()() { Log::StateMachine::Info() << "Closing connection"; }
 };
 
-// State Machine Definition
+// Application State Machine (welcome screen -> main view)
 struct AppStateController {
+  auto operator()() const noexcept {
+    using namespace sml;
+    using namespace sml::literals;
+
+    // clang-format off
+    return make_transition_table(
+      *"Welcome"_s + event<WelcomeTimerEvent> = "Main"_s);
+    // clang-format on
+  }
+};
+
+// Per-device Session State Machine. Every connected device runs its own instance.
+struct SessionStateController {
   auto operator()() const noexcept {
     using namespace sml;
     using namespace sml::literals;
 
     /**
      * Transitions:
-     * Welcome        -> Disconnected   (on WelcomeTimerEvent)
      * Disconnected   -> Connecting     (on ConnectEvent)
      * Connecting     -> FetchingSchema (on ConnectionSuccessEvent)
      * FetchingSchema -> Connected      (on SchemaReceivedEvent)
@@ -81,8 +93,7 @@ struct AppStateController {
      */
     // clang-format off
     return make_transition_table(
-      *"Welcome"_s        + event<WelcomeTimerEvent>                          = "Disconnected"_s,
-       "Disconnected"_s   + event<ConnectEvent>           / OpenConnection{}  = "Connecting"_s,
+      *"Disconnected"_s   + event<ConnectEvent>           / OpenConnection{}  = "Connecting"_s,
        "Connecting"_s     + event<ConnectionSuccessEvent> / RequestSchema{}   = "FetchingSchema"_s,
        "Connecting"_s     + event<ConnectionFailedEvent>                      = "Disconnected"_s,
        "FetchingSchema"_s + event<SchemaReceivedEvent>                        = "Connected"_s,
@@ -90,8 +101,9 @@ struct AppStateController {
        "FetchingSchema"_s + event<DisconnectEvent>        / CloseConnection{} = "Disconnected"_s,
        "Connected"_s      + event<DisconnectEvent>        / CloseConnection{} = "Disconnected"_s,
        "Connected"_s      + event<ConnectionFailedEvent>                      = "Disconnected"_s);
+    // clang-format on
   }
-    // clang-format on 
 };
 
 using AppSM = boost::sml::sm<AppStateController, boost::sml::logger<SmlLogger>>;
+using SessionSM = boost::sml::sm<SessionStateController, boost::sml::logger<SmlLogger>>;
@@ -0,0 +1,86 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <span>
+
+// Host side of one blob transfer (Protocol::kCapBlob): the bytes to send, how
+// far the device has acknowledged them, and the window of chunks in flight.
+//
+// Chunks go out back to back until a window of them is unacknowledged, and
+// every acknowledgement (cumulative: bytes received in order) slides the window
+// on. The device keeps only chunks that continue what it holds, so a lost chunk
+// shows up as repeated acknowledgements of the same offset, or as silence. Either
+// way the transfer goes back to the last acknowledged offset and sends on from
+// there (go-back-N). Chunks are views into the blob, which is never copied.
+class BlobTransfer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class State : uint8_t {
+    kIdle,
+    kOpening,     // BLOB_OPEN sent; waiting for the resume offset
+    kStreaming,   // chunks in flight
+    kCommitting,  // every byte acknowledged; BLOB_COMMIT sent
+  };
+
+  enum class Stall : uint8_t {
+    kNone,
+    kRewound,  // nothing acknowledged for a while; sending again from the last acknowledged offset
+    kGaveUp,   // kMaxStalls rewinds in a row without progress
+  };
+
+  struct Stats {
+    uint32_t total = 0;      // blob size
+    uint32_t acked = 0;      // bytes the device holds in order
+    uint32_t resumedAt = 0;  // bytes the device already held when the transfer opened
+    uint64_t chunks = 0;     // CHUNK packets sent, resends included
+    uint64_t bytesSent = 0;  // chunk bytes sent, resends included
+    uint64_t rewinds = 0;
+  };
+
+  static constexpr uint16_t kMaxChunkBytes = 1024;  // the device may ask for less
+  static constexpr uint8_t kMaxWindowChunks = 32;
+  static constexpr uint32_t kStallTimeoutMs = 1000;  // added to the request RTO
+  static constexpr uint8_t kMaxStalls = 4;
+  static constexpr uint8_t kDuplicateAcks = 3;  // repeats of one offset that count as a lost chunk
+
+  // Begins sending `data`, which must stay valid until the transfer ends, to `slot`
+  void start(uint8_t slot, std::span<const uint8_t> data);
+  // The device's BLOB_OPEN answer: where it resumes and how much it takes at once
+  void opened(uint32_t resumeAt, uint16_t chunkBytes, uint8_t windowChunks, Clock::time_point now);
+  // The next chunk the window admits; false when the window is full or everything was sent
+  bool nextChunk(uint32_t& offset, std::span<const uint8_t>& bytes) const;
+  // Records the chunk nextChunk() returned as sent
+  void sent(std::size_t bytes, Clock::time_point now);
+  // A CHUNK acknowledgement; true when it moved the window
+  bool acknowledged(uint32_t received, Clock::time_point now);
+  // Rewinds when no acknowledgement arrived for kStallTimeoutMs plus `rtoMs`
+  Stall checkStall(Clock::time_point now, uint32_t rtoMs);
+  void commit() { state = State::kCommitting; }
+  void finish() { state = State::kIdle; }
+
+  State getState() const { return state; }
+  bool active() const { return state != State::kIdle; }
+  bool allAcknowledged() const { return counters.acked == counters.total; }
+  // Chunks sent and not acknowledged yet
+  bool inFlight() const { return state == State::kStreaming && sentUpTo > counters.acked; }
+  uint8_t getSlot() const { return slot; }
+  uint32_t getCrc() const { return crc; }
+  const Stats& stats() const { return counters; }
+
+ private:
+  void rewind(Clock::time_point now);
+
+  State state = State::kIdle;
+  std::span<const uint8_t> data;
+  uint8_t slot = 0;
+  uint32_t crc = 0;  // CRC-32C of `data`
+  uint16_t chunkBytes = kMaxChunkBytes;
+  uint32_t windowBytes = 0;
+  uint32_t sentUpTo = 0;  // next offset to send
+  Clock::time_point lastAck;  // of any acknowledgement, repeats included
+  uint8_t stalls = 0;
+  uint8_t duplicates = 0;
+  uint32_t rewoundAt = UINT32_MAX;  // acked offset of the last rewind; one fast rewind per offset
+  Stats counters;
+};
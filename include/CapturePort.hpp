@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "ICommunication.hpp"
+#include "LinkTrace.hpp"
+
+// Pass-through transport that can record every chunk crossing it into a link
+// trace. Timestamps are taken when the app consumes or produces the bytes (the
+// point ProtocolHandler sees them), which is what a replay needs to reproduce.
+class CapturePort : public ICommunication {
+ public:
+  explicit CapturePort(std::unique_ptr<ICommunication> inner);
+  ~CapturePort() override;
+
+  bool open(const std::string& port, int baudRate) override { return inner->open(port, baudRate); }
+  void close() override;
+  bool isOpen() const override { return inner->isOpen(); }
+  std::size_t read(std::span<uint8_t> buffer) override;
+  std::size_t write(std::span<const uint8_t> data) override;
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks) override;
+  std::vector<std::string> listPorts() override { return inner->listPorts(); }
+
+  bool startRecording(const std::string& path);
+  void stopRecording();
+  bool isRecording() const { return writer.isOpen(); }
+  const std::string& recordingPath() const { return writer.path(); }
+
+  ICommunication* getInner() const { return inner.get(); }
+
+ private:
+  std::unique_ptr<ICommunication> inner;
+  LinkTrace::Writer writer;
+};
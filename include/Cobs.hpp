@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Consistent Overhead Byte Stuffing. An encoded frame contains no zero bytes and
+// is terminated by one, so a receiver that lost sync recovers at the next 0x00.
+// Both directions work in place: the encoder may write over input it has
+// already consumed, and the decoder never writes ahead of what it reads.
+namespace Cobs {
+
+constexpr uint8_t kDelimiter = 0x00;
+
+// Worst-case growth for `n` input bytes (one code byte per started 254-byte block)
+constexpr std::size_t MaxOverhead(std::size_t n) { return 1 + n / 254; }
+// Encoded size of `n` bytes at most, delimiter included
+constexpr std::size_t MaxFrameSize(std::size_t n) { return n + MaxOverhead(n) + 1; }
+
+// Streams one frame into `out`. Input may be passed in any number of pieces.
+// For in-place use, the input must start at least MaxOverhead(total) bytes after
+// `out`; the output then never overtakes the bytes still to be read.
+class Encoder {
+ public:
+  explicit Encoder(uint8_t* out) : start(out), code(out), cursor(out + 1) {}
+
+  void put(std::span<const uint8_t> data);
+  // Seals the last block and appends the delimiter; returns the frame size
+  std::size_t finish();
+
+ private:
+  uint8_t* start;
+  uint8_t* code;    // where the current block's length code goes
+  uint8_t* cursor;  // next output byte
+};
+
+// Decodes one frame (without its delimiter) into `out`, which may equal
+// `frame.data()`. Returns false on a zero byte or a code that overruns the frame.
+bool Decode(std::span<const uint8_t> frame, uint8_t* out, std::size_t& decodedSize);
+
+}  // namespace Cobs
@@ -3,15 +3,60 @@
 #include <string>
 #include <vector>
 #include "AppStateMachine.hpp"
+#include "CapturePort.hpp"
 #include "ICommunication.hpp"
+#include "IoLoop.hpp"
+#include "LogFormats.hpp"
+#include "MappedFile.hpp"
+#include "PortRegistry.hpp"
 #include "ProtocolHandler.hpp"
+#include "SchemaCache.hpp"
 #include "UIContext.hpp"
 
 namespace CommunicationManager {
 
+// One connected device: its transport, protocol handler, schema/state and link state machine.
+// Devices on one multi-drop bus ("<port>@<address>") each get a session; those
+// share the transport and the ProtocolHandler::Bus.
+struct Session {
+  Session(int id, const std::string& port, std::shared_ptr<ICommunication> comm);
+
+  // Disable copy (the state machine keeps a reference to the logger)
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  int id;
+  std::string port;
+  std::shared_ptr<ICommunication> comm;
+  std::shared_ptr<ProtocolHandler::Bus> bus;  // null for a point-to-point link
+  uint8_t busAddress = 0;
+  CapturePort* capture = nullptr;  // comm itself when the link can be recorded
+  std::unique_ptr<ProtocolHandler> protocol;
+  SmlLogger smlLogger;
+  SessionSM sm{smlLogger};
+  DeviceState device;
+  Protocol::ValueTypes valueTypes{};  // from the schema; lets value lists carry strings
+  MappedFile blobFile;                // mapped while Manager::sendFile streams it to the device
+  Protocol::LogFormats logFormats;    // renders the device's LOG_TOKENs
+  uint8_t logLevel = Protocol::kLogWarning;  // lowest level the device sends (Manager::setLogLevel)
+
+  // Internal Timers/Flags
+  double stateTransitionTime = 0.0;
+  bool pendingSchemaResponse = false;
+  bool schemaFailed = false;  // GET_SCHEMA went unanswered through every retry
+  bool telemetryOn = false;   // numeric values are pushed by the device (Manager::setTelemetry)
+  bool stageEdits = false;    // UI edits wait for Manager::applyStaged instead of going out at once
+  bool paged = false;         // rows are fetched as the UI shows them (Manager::loadRows)
+};
+
 class Manager {
  public:
-  Manager(AppUIContext& ctx, AppSM& sm);
+  static constexpr const char* kCaptureDir = "captures";
+  static constexpr uint32_t kTelemetryPeriodUs = 20000;  // live values at 50 Hz, about a frame each
+  static constexpr uint8_t kSchemaPageRows = 32;          // a screenful or two per GET_SCHEMA_PAGE
+  static constexpr uint8_t kValuePageRows = 255;          // READ_VALUE_PAGE rows per request
+
+  explicit Manager(AppUIContext& ctx);
   ~Manager();
 
   // Disable copy
@@ -19,32 +64,67 @@ class Manager {
   Manager& operator=(const Manager&) = delete;
 
   void update();
-  void connect(const std::string& port, int baud);
-  void disconnect();
-  bool isConnected() const;
+  // Sends everything the UI queued this frame, one write per session
+  void flush();
 
-  ProtocolHandler* getProtocol() const { return protocol.get(); }
-  ICommunication* getActiveComm() const { return activeComm; }
+  // Opens a new session (or returns the existing one for this port) and makes it active.
+  // "<port>@<address>" is the device at that address on a multi-drop bus; further
+  // addresses on the same port join the transport the first one opened.
+  Session* connect(const std::string& port, int baud, bool lowLatency = false);
+  void disconnect(int sessionId);
+  void disconnectAll();
 
-  // For listing ports
-  std::vector<std::string> listPorts();
+  const std::vector<std::unique_ptr<Session>>& getSessions() const { return sessions; }
+  Session* getSession(int sessionId) const;
+  Session* findSession(const std::string& port) const;
+  Session* getActiveSession() const { return getSession(ctx.activeSession); }
 
-  // Internal access for mocks
-  ICommunication* getRealSerial() const { return realSerial.get(); }
-  ICommunication* getMockSerial() const { return mockSerial.get(); }
+  // Starts or stops a link trace in kCaptureDir for this session
+  bool setRecording(Session& session, bool enabled);
+  // Requests the schema rows [first, last) not loaded or on their way yet; paged sessions only
+  void loadRows(Session& session, std::size_t first, std::size_t last);
+  // Reloads the values shown: a delta or full read, or one value page per run of loaded rows
+  void refreshValues(Session& session);
+  // Sends a value the user changed in the UI, or stages it while session.stageEdits is on
+  void submitEdit(Session& session, DeviceParameter& param);
+  // Sends every staged edit as one WRITE_ALL transaction (one write each if the device
+  // lacks kCapWriteAll or an id needs more than 8 bits); returns the number of edits sent
+  std::size_t applyStaged(Session& session);
+
+  // Subscribes to (or cancels) pushed updates of every numeric parameter with an
+  // 8-bit id; false when the link did not negotiate Protocol::kCapTelemetry
+  bool setTelemetry(Session& session, bool enabled);
+
+  // Makes the device send only logs of `minLevel` and up, now and after every
+  // renegotiation; false when the link did not negotiate Protocol::kCapLogTokens
+  bool setLogLevel(Session& session, uint8_t minLevel);
+
+  // Uploads a file into one of the device's blob slots (a firmware image, a table);
+  // false when the link did not negotiate Protocol::kCapBlob, an upload is already
+  // running or the file cannot be mapped. The outcome goes to the device log.
+  bool sendFile(Session& session, const std::string& path, uint8_t slot = 0);
+
+  // For listing ports (serial, extra, mock and "replay:" entries for saved traces)
+  std::vector<std::string> listPorts();
+  // Lists a port that cannot be discovered, e.g. a "unix:" or "tcp:" socket URI
+  void addPort(const std::string& port);
+  // Applies hotplug events; returns true when listPorts() would change
+  bool pollPorts();
+  const PortRegistry& getPortRegistry() const { return portRegistry; }
 
  private:
-  void setupProtocol();
+  std::unique_ptr<ICommunication> createTransport(const std::string& port, bool lowLatency);
+  void setupProtocol(Session& session);
 
   AppUIContext& ctx;
-  AppSM& sm;
-
-  std::unique_ptr<ICommunication> realSerial;
-  std::unique_ptr<ICommunication> mockSerial;
-  ICommunication* activeComm = nullptr;
 
-  std::unique_ptr<ProtocolHandler> protocol;
-  bool pendingSchemaResponse = false;
+  PortRegistry portRegistry;
+  IoLoop ioLoop;  // one I/O thread shared by every serial session
+  SchemaCache schemaCache;  // schemas of known devices, reused on reconnect
+  std::vector<std::unique_ptr<Session>> sessions;
+  std::vector<std::string> extraPorts;
+  int nextSessionId = 0;
+  bool portsDirty = false;  // a new trace appeared in kCaptureDir
 };
 
 }  // namespace CommunicationManager
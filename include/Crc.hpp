@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+// Table-driven CRC kernels for the link integrity modes. Both are chainable:
+// pass the previous result to continue over discontiguous buffers.
+namespace Crc {
+
+// CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF, MSB first, no final XOR
+constexpr uint16_t kCrc16Init = 0xFFFF;
+uint16_t Crc16Ccitt(std::span<const uint8_t> data, uint16_t crc = kCrc16Init);
+
+// CRC-32C (Castagnoli): reflected poly 0x82F63B78, init/final XOR 0xFFFFFFFF.
+// Uses the SSE4.2 crc32 instruction when the CPU has it, slice-by-8 otherwise.
+uint32_t Crc32c(std::span<const uint8_t> data, uint32_t crc = 0);
+
+// Which CRC-32C kernel Crc32c() dispatches to ("sse4.2" or "slice-by-8")
+const char* Crc32cImplementation();
+
+}  // namespace Crc
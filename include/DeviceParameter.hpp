@@ -4,7 +4,7 @@
 #include "Protocol.hpp"
 
 struct DeviceParameter {
-  uint8_t id;
+  uint16_t id;
   Protocol::ParamType type;
   std::string name;
   float value;
@@ -14,7 +14,12 @@ struct DeviceParameter {
 
   // UI State
   bool pending = false;
+  bool staged = false;  // edited while batching; goes out with the next WRITE_ALL
   float lastSentValue = 0.0f;
   std::string lastSentString;
   bool editMode = false;
+
+  // Paged schemas (Protocol::kCapPaged) fill in rows as they scroll into view
+  bool loaded = true;
+  bool loading = false;  // its schema page is requested
 };
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -10,7 +11,17 @@ class ICommunication {
   virtual bool open(const std::string& port, int baudRate) = 0;
   virtual void close() = 0;
   virtual bool isOpen() const = 0;
-  virtual std::size_t write(const std::vector<uint8_t>& data) = 0;
-  virtual std::vector<uint8_t> read(std::size_t maxSize) = 0;
+
+  // Copies up to buffer.size() received bytes into the caller's buffer. Never blocks.
+  virtual std::size_t read(std::span<uint8_t> buffer) = 0;
+  virtual std::size_t write(std::span<const uint8_t> data) = 0;
+
+  // Scatter-gather write: the chunks go out back to back as one stream.
+  virtual std::size_t writev(std::span<const std::span<const uint8_t>> chunks) {
+    std::size_t total = 0;
+    for (auto chunk : chunks) total += write(chunk);
+    return total;
+  }
+
   virtual std::vector<std::string> listPorts() = 0;
 };
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+#include "SpscRing.hpp"
+
+class IoLoop;
+
+// A file descriptor serviced by an IoLoop. The loop thread drains the fd into `rx`
+// and flushes `tx` to it; the owning (UI) thread only touches the rings.
+class IoChannel {
+ public:
+  static constexpr std::size_t kRingSize = 64 * 1024;
+
+  // Consumer side: pop received bytes. Never blocks.
+  std::size_t read(std::span<uint8_t> buffer);
+  // Producer side: queue bytes for transmission. Returns how many were accepted.
+  std::size_t write(std::span<const uint8_t> data);
+  // Queues all chunks or none of them, so a packet is never split by a full ring.
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks);
+
+  bool hasFailed() const { return failed.load(std::memory_order_acquire); }
+  std::size_t pendingRx() const { return rx.size(); }
+  std::size_t pendingTx() const { return tx.size(); }
+
+ private:
+  friend class IoLoop;
+
+  int fd = -1;
+  IoLoop* loop = nullptr;
+  uint32_t interest = 0;  // epoll events currently registered (loop thread only)
+  std::atomic<bool> rxPaused{false};
+  std::atomic<bool> failed{false};
+  SpscRing<kRingSize> rx;
+  SpscRing<kRingSize> tx;
+};
+
+// epoll-driven I/O thread. Attached channels are drained completely whenever the
+// kernel reports data, so throughput no longer depends on how often the UI polls.
+class IoLoop {
+ public:
+  IoLoop();
+  ~IoLoop();
+
+  // Disable copy
+  IoLoop(const IoLoop&) = delete;
+  IoLoop& operator=(const IoLoop&) = delete;
+
+  bool isRunning() const { return running.load(std::memory_order_acquire); }
+
+  // Thread-safe. The fd must already be non-blocking.
+  bool attach(IoChannel& channel, int fd);
+  // Thread-safe. Once this returns the loop no longer touches the channel.
+  void detach(IoChannel& channel);
+
+  // Ask the loop thread to service pending TX and paused RX.
+  void wake();
+
+ private:
+  void run();
+  void drainRx(IoChannel& ch);
+  void flushTx(IoChannel& ch);
+  void setInterest(IoChannel& ch, uint32_t events);
+  void fail(IoChannel& ch);
+
+  int epollFd = -1;
+  int wakeFd = -1;
+  std::atomic<bool> running{false};
+  std::atomic<bool> wakePending{false};
+  std::mutex mutex;
+  std::vector<IoChannel*> channels;
+  std::thread thread;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Append-only binary capture of link traffic.
+//
+// Layout: FileHeader, then back-to-back records (RecordHeader + bytes). Closing
+// a Writer appends a seek index (one IndexEntry per kIndexStride bytes of
+// records) and a fixed-size Footer, so a Reader can open a capture of any size
+// without scanning it. A capture that was never closed (crash, power loss) has
+// no footer; the Reader then rebuilds the index with one linear pass and stops
+// at the last complete record. All integers are little endian.
+namespace LinkTrace {
+
+enum class Direction : uint8_t {
+  kRx = 0,  // device -> app
+  kTx = 1,  // app -> device
+};
+
+#pragma pack(push, 1)
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t startNs;  // CLOCK_MONOTONIC at capture start
+};
+
+struct RecordHeader {
+  uint64_t timeNs;  // relative to FileHeader::startNs
+  uint8_t direction;
+  uint32_t length;
+};
+
+struct IndexEntry {
+  uint64_t timeNs;
+  uint64_t offset;  // file offset of a RecordHeader
+};
+
+struct Footer {
+  uint64_t indexOffset;
+  uint64_t indexCount;
+  uint64_t recordCount;
+  uint64_t endNs;
+  char magic[8];
+};
+#pragma pack(pop)
+
+constexpr char kFileMagic[8] = {'Z', 'A', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr char kFooterMagic[8] = {'Z', 'A', 'T', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kIndexStride = 1024 * 1024;
+
+struct Record {
+  uint64_t timeNs = 0;
+  Direction direction = Direction::kRx;
+  std::span<const uint8_t> data;
+};
+
+class Writer {
+ public:
+  Writer() = default;
+  ~Writer();
+
+  // Disable copy
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  bool open(const std::string& path);
+  // Writes the index and footer; the file is complete afterwards
+  void close();
+  bool isOpen() const { return fd >= 0; }
+  const std::string& path() const { return filePath; }
+
+  void append(Direction direction, std::span<const uint8_t> data);
+  // A scatter-gather write is stored as one record
+  void append(Direction direction, std::span<const std::span<const uint8_t>> chunks);
+  // Writes out buffered records once kFlushIntervalNs has passed since the last
+  // write-out. append() only checks while traffic flows, so the owner calls this
+  // periodically to get the tail of a burst onto disk when the link goes quiet.
+  void poll();
+
+ private:
+  void beginRecord(Direction direction, std::size_t length);
+  void put(std::span<const uint8_t> bytes);
+  void flushBuffer();
+  void flushIfDue(uint64_t now);
+
+  static constexpr std::size_t kBufferSize = 64 * 1024;
+  static constexpr uint64_t kFlushIntervalNs = 1'000'000'000;  // with poll(), bounds loss on a crash
+
+  int fd = -1;
+  std::string filePath;
+  uint64_t startNs = 0;
+  uint64_t lastFlushNs = 0;
+  uint64_t offset = 0;  // file offset of the next record
+  uint64_t nextIndexOffset = 0;
+  uint64_t recordCount = 0;
+  uint64_t lastTimeNs = 0;
+  std::vector<IndexEntry> index;
+  std::vector<uint8_t> buffer;
+};
+
+// Read-only view of a capture through a MappedFile; records are returned as spans
+// into the mapping, so iterating costs no copies.
+class Reader {
+ public:
+  Reader() = default;
+  ~Reader();
+
+  // Disable copy
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const { return file.isOpen(); }
+
+  uint64_t recordCount() const { return records; }
+  uint64_t durationNs() const { return endNs; }
+  uint64_t sizeBytes() const { return dataEnd - sizeof(FileHeader); }
+  // False when the capture had no footer and the index was rebuilt by scanning
+  bool wasIndexed() const { return hadFooter; }
+
+  // Offset of the first record. next() reads the record at `offset` and advances it.
+  uint64_t begin() const { return sizeof(FileHeader); }
+  bool next(uint64_t& offset, Record& record) const;
+  // Offset of the first record at or after `timeNs`
+  uint64_t seek(uint64_t timeNs) const;
+
+ private:
+  bool loadFooter();
+  void scan();
+
+  MappedFile file;
+  uint64_t dataEnd = 0;
+  uint64_t records = 0;
+  uint64_t endNs = 0;
+  bool hadFooter = false;
+  std::vector<IndexEntry> index;
+};
+
+}  // namespace LinkTrace
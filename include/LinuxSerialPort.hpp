@@ -1,25 +1,39 @@
 #pragma once
 #include <fcntl.h>
-#include <termios.h>
 #include <unistd.h>
+#include <memory>
 #include <string>
 #include <vector>
 #include "ICommunication.hpp"
+#include "IoLoop.hpp"
 
 class LinuxSerialPort : public ICommunication {
  public:
-  LinuxSerialPort();
+  // With a shared loop the port is serviced by that thread; otherwise open()
+  // starts a private I/O thread for this port.
+  explicit LinuxSerialPort(IoLoop* sharedLoop = nullptr);
   ~LinuxSerialPort() override;
 
   bool open(const std::string& port, int baudRate) override;
   void close() override;
   bool isOpen() const override;
-  std::size_t write(const std::vector<uint8_t>& data) override;
-  std::vector<uint8_t> read(std::size_t maxSize) override;
+  std::size_t read(std::span<uint8_t> buffer) override;
+  std::size_t write(std::span<const uint8_t> data) override;
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks) override;
   std::vector<std::string> listPorts() override;
 
+  // Opt-in, applied on the next open(): sets ASYNC_LOW_LATENCY, so USB-serial
+  // drivers hand received bytes over at once instead of after their latency timer.
+  void setLowLatency(bool enabled) { lowLatency = enabled; }
+  bool isLowLatency() const { return lowLatency; }
+
  private:
   int fd;
-  struct termios tty;
-  speed_t translateBaud(int baudRate);
+  bool lowLatency = false;
+  IoLoop* sharedLoop;
+  std::unique_ptr<IoLoop> ownLoop;
+  IoLoop* ioLoop = nullptr;
+  IoChannel channel;
+  void applyLowLatency(const std::string& port);
+  static unsigned int translateBaud(int baudRate);
 };
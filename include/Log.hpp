@@ -7,4 +7,7 @@ using Protocol = sb::logger::Logger<"Protocol">;
 using App = sb::logger::Logger<"App">;
 using StateMachine = sb::logger::Logger<"StateMachine">;
 using SerialMock = sb::logger::Logger<"Mock">;
+using Serial = sb::logger::Logger<"Serial">;
+using Device = sb::logger::Logger<"Device">;
+using Trace = sb::logger::Logger<"Trace">;
 }  // namespace Log
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ProtocolViews.hpp"
+
+// Tokenized device logs (Protocol::kCapLogTokens). The device keeps its log
+// messages as a table of format strings and sends only a format id and the
+// binary arguments; the host asks for the table once per link and renders the
+// text itself. "Value updated: %g" costs 6 payload bytes, its text 20 or more.
+//
+// Placeholders take the arguments in order, little endian: %d an int32, %u a
+// uint32, %g a float32, %s a Wire::Str8 string; %% is a percent sign.
+namespace Protocol {
+
+// `format` with its placeholders filled from `args`; those the arguments run
+// out before show as "?"
+std::string FormatLog(std::string_view format, std::span<const uint8_t> args);
+
+// The host's copy of a device's format table, from its LOG_FORMATS answer
+class LogFormats {
+ public:
+  void load(LogFormatsView view);
+  void clear() { formats.clear(); }
+  bool empty() const { return formats.empty(); }
+
+  // A LOG_TOKEN as text; "format <id>" and the arguments in hex if the table lacks `id`
+  std::string render(uint8_t id, std::span<const uint8_t> args) const;
+
+ private:
+  std::vector<std::string> formats;  // by id; empty for ids the device did not list
+};
+
+}  // namespace Protocol
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// LZSS with a 4 KiB window, small enough for a microcontroller to encode with
+// a couple of KiB of tables and to decode with no memory beyond its output.
+//
+// The stream is a series of groups: a flag byte, then up to eight items, least
+// significant flag first. A clear flag is one literal byte; a set flag is a
+// back reference of two bytes, little endian: (distance - 1) in the low 12
+// bits, (length - kMinMatch) in the high 4.
+namespace Lz {
+
+constexpr std::size_t kWindow = 4096;
+constexpr std::size_t kMinMatch = 3;
+constexpr std::size_t kMaxMatch = kMinMatch + 15;
+
+// Worst-case encoded size of `n` bytes (all literals)
+constexpr std::size_t MaxEncodedSize(std::size_t n) { return n + (n + 7) / 8; }
+
+// Compresses `in` into `out`. Returns the encoded size, or 0 when it would not
+// be smaller than the input (the caller then sends it as is). Keeps its match
+// tables between calls, so one Encoder per link avoids reallocating them.
+class Encoder {
+ public:
+  Encoder();
+  std::size_t encode(std::span<const uint8_t> in, std::span<uint8_t> out);
+
+ private:
+  static constexpr std::size_t kHashBits = 12;
+  static constexpr int kMaxChain = 16;  // candidates tried per position
+
+  std::vector<int32_t> head;  // last position per 3-byte hash, -1 if none
+  std::vector<int32_t> prev;  // previous position with the same hash, by position % kWindow
+};
+
+// Expands `in` into `out` (cleared first; its capacity is reused). Returns false
+// on a reference before the start of the output or when the output would
+// exceed `maxSize`.
+bool Decode(std::span<const uint8_t> in, std::vector<uint8_t>& out, std::size_t maxSize);
+
+}  // namespace Lz
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+
+// A file mapped read-only, so a large blob (a firmware image, a calibration
+// table), a cached schema or a link trace is read straight from the page cache
+// instead of being copied into memory first. The mapping is advised for
+// sequential access.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // Maps `path`; false (after logging why) when it cannot be opened or is empty
+  bool open(const std::string& path);
+  void close();
+
+  bool isOpen() const { return map != nullptr; }
+  std::span<const uint8_t> bytes() const { return {map, mapSize}; }
+  const std::string& path() const { return filePath; }
+
+ private:
+  const uint8_t* map = nullptr;
+  std::size_t mapSize = 0;
+  std::string filePath;
+};
@@ -2,20 +2,12 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <span>
 #include <vector>
 #include "ICommunication.hpp"
 #include "Log.hpp"
 #include "Protocol.hpp"
-
-struct MockParam {
-  uint8_t id;
-  uint8_t type;
-  std::string name;
-  float value;
-  float min;
-  float max;
-  std::string stringValue;
-};
+#include "SimulatedDevice.hpp"
 
 struct DelayedResponse {
   std::chrono::steady_clock::time_point readyTime;
@@ -31,27 +23,11 @@ class MockSerialPort : public ICommunication {
       isOpenFlag = true;
       activePortName = port;
 
-      params.clear();
-      if (port == "ttyMock1") {
-        params = {{0, static_cast<uint8_t>(Protocol::ParamType::kToggle), "Mock1 Power", 1.0f, 0.0f, 1.0f, ""},
-                  {1, static_cast<uint8_t>(Protocol::ParamType::kSlider), "Mock1 Level", 50.0f, 0.0f, 100.0f, ""}};
-      } else if (port == "ttyMock2") {
-        params = {{10, static_cast<uint8_t>(Protocol::ParamType::kToggle), "Mock2 Turbo", 0.0f, 0.0f, 1.0f, ""},
-                  {11, static_cast<uint8_t>(Protocol::ParamType::kToggle), "Mock2 LED", 1.0f, 0.0f, 1.0f, ""},
-                  {12, static_cast<uint8_t>(Protocol::ParamType::kSlider), "Mock2 Speed", 25.0f, 0.0f, 200.0f, ""},
-                  {13, static_cast<uint8_t>(Protocol::ParamType::kNumeric), "Mock2 Goal", 150.0f, 0.0f, 500.0f, ""}};
-      } else if (port == "ttyMock3") {
-        params = {{20, static_cast<uint8_t>(Protocol::ParamType::kToggle), "Tgl 1", 0.0f, 0.0f, 1.0f, ""},
-                  {21, static_cast<uint8_t>(Protocol::ParamType::kToggle), "Tgl 2", 1.0f, 0.0f, 1.0f, ""},
-                  {22, static_cast<uint8_t>(Protocol::ParamType::kSlider), "Sld 1", 10.0f, 0.0f, 100.0f, ""},
-                  {23, static_cast<uint8_t>(Protocol::ParamType::kSlider), "Sld 2", 80.0f, 0.0f, 100.0f, ""},
-                  {24, static_cast<uint8_t>(Protocol::ParamType::kNumeric), "Num 1", 123.0f, 0.0f, 1000.0f, ""},
-                  {25, static_cast<uint8_t>(Protocol::ParamType::kNumeric), "Num 2", 456.0f, 0.0f, 1000.0f, ""},
-                  {26, static_cast<uint8_t>(Protocol::ParamType::kString), "Str 1", 0.0f, 0.0f, 0.0f, "Hello"},
-                  {27, static_cast<uint8_t>(Protocol::ParamType::kString), "Str 2", 0.0f, 0.0f, 0.0f, "World"}};
-      }
+      device = SimulatedDevice(port);
+      device.setParams(SimulatedDevice::preset(port));
+      device.setCapabilities(0);  // the mock frames everything with the legacy XOR checksum
 
-      Log::SerialMock::Info() << "Connected to " << port << " with " << params.size() << " parameters.";
+      Log::SerialMock::Info() << "Connected to " << port << " with " << device.getParams().size() << " parameters.";
       return true;
     }
     return false;
@@ -67,92 +43,30 @@ class MockSerialPort : public ICommunication {
 
   bool isOpen() const override { return isOpenFlag; }
 
-  std::size_t write(const std::vector<uint8_t>& data) override {
-    if (!isOpenFlag || data.size() < sizeof(Protocol::PacketHeader)) return 0;
-
-    const auto* header = reinterpret_cast<const Protocol::PacketHeader*>(data.data());
-    if (header->startByte != Protocol::kStartByte) return 0;
-
-    Protocol::Command cmd = static_cast<Protocol::Command>(header->command);
-
-    std::vector<uint8_t> payload;
-    switch (cmd) {
-      case Protocol::Command::kPing:
-        payload = {0x01};
-        break;
-
-      case Protocol::Command::kGetSchema: {
-        payload.push_back(static_cast<uint8_t>(params.size()));
-        for (const auto& p : params) {
-          payload.push_back(p.id);
-          payload.push_back(p.type);
-          payload.push_back(static_cast<uint8_t>(p.name.size()));
-          payload.insert(payload.end(), p.name.begin(), p.name.end());
-          uint8_t minMax[8];
-          std::memcpy(minMax, &p.min, 4);
-          std::memcpy(minMax + 4, &p.max, 4);
-          payload.insert(payload.end(), minMax, minMax + 8);
-        }
-        break;
-      }
-
-      case Protocol::Command::kReadAll: {
-        payload.push_back(static_cast<uint8_t>(params.size()));
-        for (const auto& p : params) {
-          payload.push_back(p.id);
-          if (p.type == static_cast<uint8_t>(Protocol::ParamType::kString)) {
-            payload.push_back(static_cast<uint8_t>(p.stringValue.size()));
-            payload.insert(payload.end(), p.stringValue.begin(), p.stringValue.end());
-          } else {
-            uint8_t valBytes[4];
-            std::memcpy(valBytes, &p.value, 4);
-            payload.insert(payload.end(), valBytes, valBytes + 4);
-          }
-        }
-        break;
-      }
-
-      case Protocol::Command::kWriteValue: {
-        uint8_t id = 0xFF;
-        if (data.size() >= sizeof(Protocol::PacketHeader) + 1) {
-          id = data[sizeof(Protocol::PacketHeader)];
-          for (auto& p : params) {
-            if (p.id == id) {
-              if (p.type == static_cast<uint8_t>(Protocol::ParamType::kString)) {
-                uint8_t strLen = data[sizeof(Protocol::PacketHeader) + 1];
-                p.stringValue =
-                    std::string(reinterpret_cast<const char*>(&data[sizeof(Protocol::PacketHeader) + 2]), strLen);
-                Log::SerialMock::Info() << "[" << activePortName << "] Param " << (int)id << " updated to \""
-                                        << p.stringValue << "\" (ACK in 500ms)";
-                queueLog(0, "String parameter updated: " + p.stringValue);
-              } else {
-                float newVal;
-                std::memcpy(&newVal, &data[sizeof(Protocol::PacketHeader) + 1], 4);
-                p.value = newVal;
-                Log::SerialMock::Info() << "[" << activePortName << "] Param " << (int)id << " updated to " << newVal
-                                        << " (ACK in 500ms)";
-                queueLog(0, "Value updated: " + std::to_string(newVal));
-                if (newVal > 90.0f) queueLog(1, "Warning: Value is high!");
-              }
-              break;
-            }
-          }
-        }
-        payload = {id};
-        break;
-      }
-      default:
-        break;
-    }
-
-    if (!payload.empty() || cmd == Protocol::Command::kPing) {
-      queueDelayedResponse(cmd, payload);
+  std::size_t write(std::span<const uint8_t> data) override {
+    if (!isOpenFlag) return 0;
+
+    // A coalesced write may carry several packets back to back
+    std::size_t offset = 0;
+    while (data.size() - offset >= sizeof(Protocol::PacketHeader)) {
+      const auto* header = reinterpret_cast<const Protocol::PacketHeader*>(data.data() + offset);
+      if (header->startByte != Protocol::kStartByte) break;
+      std::size_t packetSize = sizeof(Protocol::PacketHeader) + header->length + 1;
+      if (offset + packetSize > data.size()) break;
+      handlePacket(data.subspan(offset, packetSize));
+      offset += packetSize;
     }
-
     return data.size();
   }
 
-  std::vector<uint8_t> read(std::size_t maxSize) override {
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks) override {
+    // The device model needs whole packets; gather into a reused scratch buffer
+    txScratch.clear();
+    for (auto chunk : chunks) txScratch.insert(txScratch.end(), chunk.begin(), chunk.end());
+    return write(txScratch);
+  }
+
+  std::size_t read(std::span<uint8_t> buffer) override {
     auto now = std::chrono::steady_clock::now();
     auto it = delayedResponses.begin();
     while (it != delayedResponses.end()) {
@@ -164,42 +78,48 @@ class MockSerialPort : public ICommunication {
       }
     }
 
-    if (activeBuffer.empty()) return {};
-    std::size_t size = std::min(maxSize, activeBuffer.size());
-    std::vector<uint8_t> chunk(activeBuffer.begin(), activeBuffer.begin() + size);
+    if (activeBuffer.empty()) return 0;
+    std::size_t size = std::min(buffer.size(), activeBuffer.size());
+    std::memcpy(buffer.data(), activeBuffer.data(), size);
     activeBuffer.erase(activeBuffer.begin(), activeBuffer.begin() + size);
-    return chunk;
+    return size;
   }
 
   std::vector<std::string> listPorts() override { return {"ttyMock1", "ttyMock2", "ttyMock3"}; }
 
+  // Time before a response becomes readable; 0 answers on the next read
+  void setResponseDelay(std::chrono::milliseconds delay) { responseDelay = delay; }
+
  private:
-  void queueLog(uint8_t level, const std::string& msg) {
-    std::vector<uint8_t> payload;
-    payload.push_back(level);
-    payload.insert(payload.end(), msg.begin(), msg.end());
-    queueDelayedResponse(Protocol::Command::kLog, payload);
+  void handlePacket(std::span<const uint8_t> data) {
+    const auto* header = reinterpret_cast<const Protocol::PacketHeader*>(data.data());
+    Protocol::Command cmd = static_cast<Protocol::Command>(header->command);
+    auto payload = data.subspan(sizeof(Protocol::PacketHeader), header->length);
+    device.handleCommand(cmd, payload, [this](Protocol::Command c, std::span<const uint8_t> p) {
+      queueDelayedResponse(c, p);
+    });
   }
 
-  void queueDelayedResponse(Protocol::Command cmd, const std::vector<uint8_t>& payload) {
+  void queueDelayedResponse(Protocol::Command cmd, std::span<const uint8_t> payload) {
     Protocol::PacketHeader header;
     header.startByte = Protocol::kStartByte;
     header.command = static_cast<uint8_t>(cmd);
     header.length = static_cast<uint16_t>(payload.size());
 
-    std::vector<uint8_t> fullPacket;
-    uint8_t* hPtr = reinterpret_cast<uint8_t*>(&header);
-    fullPacket.insert(fullPacket.end(), hPtr, hPtr + sizeof(header));
-    fullPacket.insert(fullPacket.end(), payload.begin(), payload.end());
-    fullPacket.push_back(Protocol::CalculateChecksum(payload));
-
-    auto readyTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
-    delayedResponses.push_back({readyTime, fullPacket});
+    auto readyTime = std::chrono::steady_clock::now() + responseDelay;
+    auto& response = delayedResponses.emplace_back(DelayedResponse{readyTime, {}});
+    response.data.reserve(sizeof(header) + payload.size() + 1);
+    const uint8_t* hPtr = reinterpret_cast<const uint8_t*>(&header);
+    response.data.insert(response.data.end(), hPtr, hPtr + sizeof(header));
+    response.data.insert(response.data.end(), payload.begin(), payload.end());
+    response.data.push_back(Protocol::CalculateChecksum(payload));
   }
 
   bool isOpenFlag;
   std::string activePortName;
-  std::vector<MockParam> params;
+  SimulatedDevice device;
   std::vector<uint8_t> activeBuffer;
+  std::vector<uint8_t> txScratch;
   std::vector<DelayedResponse> delayedResponses;
+  std::chrono::milliseconds responseDelay{500};
 };
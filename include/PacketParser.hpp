@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Cobs.hpp"
+#include "Protocol.hpp"
+
+// Incremental RX framing over a fixed buffer allocated once. Bytes are read
+// straight into writeSpace(); next() then yields complete, integrity-checked
+// packets as views into that buffer. Consumed bytes are reclaimed by sliding
+// the unparsed tail (at most one partial packet) to the front, so the cost per
+// byte stays constant no matter how noisy the line is.
+//
+// In COBS framing each frame is decoded in place once its delimiter arrives. A
+// damaged frame is dropped whole and parsing resumes at the next delimiter, so
+// a glitch costs at most the frame it hit.
+//
+// On a negotiated single-device link the parser also takes a capability PING
+// framed the legacy way (start byte, XOR trailer) and flags it: that is a host
+// starting over, and the device drops back to legacy framing to answer it.
+class PacketParser {
+ public:
+  struct Packet {
+    Protocol::Command command;
+    std::span<const uint8_t> payload;  // valid until the next writeSpace()
+    uint8_t sequence = 0;              // 0 unless the link is sequenced
+    uint8_t address = 0;               // drop address; 0 unless the link is addressed
+    bool legacy = false;               // a legacy-framed capability PING on a negotiated link
+  };
+
+  struct Stats {
+    uint64_t packets = 0;
+    uint64_t checksumErrors = 0;
+    uint64_t oversized = 0;     // headers announcing more than kMaxPayload
+    uint64_t droppedBytes = 0;  // skipped while resynchronizing
+    uint64_t framingErrors = 0;  // COBS frames that failed to decode or had a bad header
+    uint64_t legacyPings = 0;    // capability PINGs in legacy framing on a negotiated link
+  };
+
+  static constexpr std::size_t kMaxPayload = 16 * 1024;
+  static constexpr std::size_t kCapacity = 64 * 1024;
+  static constexpr std::size_t kMaxPacket = Protocol::kMaxHeaderSize + kMaxPayload + Protocol::kMaxTrailerSize;
+  static constexpr std::size_t kMaxFrame = Cobs::MaxFrameSize(kMaxPacket);
+  static_assert(kCapacity >= 2 * kMaxFrame, "a maximal packet must fit alongside a read chunk");
+
+  PacketParser();
+
+  // Contiguous free space for the next read; commit() the bytes written to it
+  std::span<uint8_t> writeSpace();
+  void commit(std::size_t n);
+
+  // Extracts the next complete packet. Returns false when more bytes are needed.
+  bool next(Packet& packet);
+
+  // Applies to every packet not yet returned by next()
+  void setLinkConfig(const Protocol::LinkConfig& config);
+  const Protocol::LinkConfig& getLinkConfig() const { return link; }
+
+  void reset();
+  std::size_t buffered() const { return tail - head; }
+  const Stats& stats() const { return counters; }
+
+ private:
+  enum class State : uint8_t { kHunting, kHeader, kPayload, kDiscarding };
+  enum class LegacyMatch : uint8_t { kNo, kPartial, kYes };
+
+  bool nextStartByte(Packet& packet);
+  bool nextCobs(Packet& packet);
+  // Checks a decoded COBS frame; on success fills `packet` with views into it
+  bool acceptFrame(const uint8_t* data, std::size_t size, Packet& packet);
+  void resync();
+  // Takes a legacy PING starting at `at` as the next packet, if the link needs
+  // that and the bytes hold one; kPartial while they could still become one
+  LegacyMatch takeLegacyPing(std::size_t at, Packet& packet);
+
+  Protocol::LinkConfig link;
+  std::vector<uint8_t> buffer;
+  std::size_t head = 0;  // first unparsed byte
+  std::size_t tail = 0;  // end of received data
+  std::size_t scanned = 0;  // COBS: bytes up to here hold no delimiter
+  State state = State::kHunting;
+  uint8_t pendingCommand = 0;
+  std::size_t pendingLength = 0;  // payload length once the header is accepted
+  Stats counters;
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Metadata read once from sysfs when a port appears
+struct PortInfo {
+  std::string path;       // e.g. /dev/ttyUSB0
+  std::string driver;     // e.g. ftdi_sio, cp210x, cdc_acm
+  std::string vendorId;   // USB idVendor, hex
+  std::string productId;  // USB idProduct, hex
+  std::string serial;
+  std::string product;
+};
+
+// Incrementally maintained list of serial ports. One sysfs scan at startup, then
+// inotify on /dev keeps it current as devices are plugged and unplugged.
+class PortRegistry {
+ public:
+  PortRegistry();
+  ~PortRegistry();
+
+  // Disable copy
+  PortRegistry(const PortRegistry&) = delete;
+  PortRegistry& operator=(const PortRegistry&) = delete;
+
+  // Non-blocking. Applies pending hotplug events; returns true if the list changed.
+  bool poll();
+
+  const std::vector<PortInfo>& ports() const { return entries; }
+  const PortInfo* find(const std::string& path) const;
+
+ private:
+  void scan();
+  bool add(const std::string& name);
+  bool remove(const std::string& name);
+
+  static bool isSerialName(const std::string& name);
+  static PortInfo readSysfs(const std::string& name);
+
+  int inotifyFd = -1;
+  std::vector<PortInfo> entries;
+};
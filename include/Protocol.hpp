@@ -1,7 +1,9 @@
 #pragma once
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
+#include "Crc.hpp"
 
 namespace Protocol {
 
@@ -10,11 +12,24 @@ constexpr uint8_t kStartByte = 0xAA;
 enum class Command : uint8_t {
   kPing = 0x00,
   kGetSchema = 0x10,
+  kGetSchemaPage = 0x11,
   kReadValue = 0x20,
   kReadAll = 0x21,
+  kReadChanges = 0x22,
+  kReadValuePage = 0x23,
   kWriteValue = 0x30,
   kWriteAll = 0x31,
-  kLog = 0x40
+  kWriteValueWide = 0x32,
+  kLog = 0x40,
+  kLogFormats = 0x41,
+  kLogToken = 0x42,
+  kSetLogLevel = 0x43,
+  kSubscribe = 0x50,
+  kUnsubscribe = 0x51,
+  kTelemetry = 0x52,
+  kBlobOpen = 0x60,
+  kBlobChunk = 0x61,
+  kBlobCommit = 0x62
 };
 
 enum class ParamType : uint8_t { kToggle = 0x01, kSlider = 0x02, kNumeric = 0x03, kString = 0x04 };
@@ -28,10 +43,201 @@ struct PacketHeader {
 #pragma pack(pop)
 
 // Utility to calculate a simple XOR checksum
-inline uint8_t CalculateChecksum(const std::vector<uint8_t>& data) {
+inline uint8_t CalculateChecksum(std::span<const uint8_t> data) {
   uint8_t checksum = 0;
   for (uint8_t b : data) checksum ^= b;
   return checksum;
 }
 
+// --- Link negotiation ---
+// A host that wants more than the legacy XOR checksum sends CMD_PING with
+// [kCapabilityVersion, capability bits]. A device that understands it answers
+// [kPingAck, kCapabilityVersion, its capability bits, selected Integrity] and
+// switches after sending that answer; the host switches when it arrives.
+// Legacy devices answer [kPingAck] and the link stays on XOR. A device that
+// also offers kCapCobs appends the selected Framing as a fifth byte. Sequence
+// ids are on when both capability bytes carry kCapSequence. A device may then
+// add the HashSchema() of its GET_SCHEMA payload (Wire::SchemaHash), sending
+// the framing byte even without kCapCobs, so a host that cached the schema
+// under that hash can skip fetching it.
+//
+// The offer always goes out with start byte framing and an XOR trailer. A
+// device left negotiated by an earlier session takes it in any mode, drops back
+// to legacy framing to answer, and then switches as usual (PacketParser flags it).
+//
+// Capabilities past the first eight travel in one extension byte: the host
+// appends it to its PING, and the device puts its own after the schema hash
+// (sending a zero hash if it reports none). Both count as bits 8-15 here.
+//
+// With kCapCompression either side may send any packet but PING with an
+// Lz-compressed payload, marked by kCompressedFlag in the command byte.
+
+constexpr uint8_t kPingAck = 0x01;
+constexpr uint8_t kCapabilityVersion = 1;
+
+constexpr uint16_t kCapCrc16 = 0x01;
+constexpr uint16_t kCapCrc32c = 0x02;
+constexpr uint16_t kCapCobs = 0x04;
+constexpr uint16_t kCapSequence = 0x08;
+constexpr uint16_t kCapReadChanges = 0x10;
+constexpr uint16_t kCapTelemetry = 0x20;
+constexpr uint16_t kCapCompression = 0x40;
+constexpr uint16_t kCapWriteAll = 0x80;
+// Extension byte
+constexpr uint16_t kCapPaged = 0x0100;  // paged schema and values with 16-bit ids
+constexpr uint16_t kCapBlob = 0x0200;   // bulk blob transfers (firmware images, calibration tables)
+constexpr uint16_t kCapLogTokens = 0x0400;  // logs as format id + binary arguments, and a minimum log level
+constexpr uint16_t kAllCapabilities = kCapCrc16 | kCapCrc32c | kCapCobs | kCapSequence | kCapReadChanges |
+                                      kCapTelemetry | kCapCompression | kCapWriteAll | kCapPaged | kCapBlob |
+                                      kCapLogTokens;
+
+// Log levels of CMD_LOG and LOG_TOKEN
+constexpr uint8_t kLogInfo = 0;
+constexpr uint8_t kLogWarning = 1;
+constexpr uint8_t kLogError = 2;
+
+// With kCapPaged the schema and values can also be read in pages of rows,
+// addressed by index in the schema, and parameters carry 16-bit ids:
+// GET_SCHEMA_PAGE and READ_VALUE_PAGE ask for [first row, row count] and the
+// device answers up to that many rows (fewer if they would not fit, but at least
+// one unless `first` is past the end); WRITE_VALUE_WIDE is WRITE_VALUE with a
+// 16-bit id. The 8-bit commands keep covering ids 0-255.
+
+// With kCapBlob the host can stream a large blob into one of the device's slots:
+// BLOB_OPEN announces its size and CRC-32C and learns how much of it the device
+// already holds, CHUNKs carry [offset, bytes] and are acknowledged with the
+// number of bytes received in order so far, and BLOB_COMMIT asks the device to
+// check the whole blob and keep it. Chunks are not tracked one by one: the host
+// keeps a window of them in flight and goes back to the last acknowledged
+// offset when the acknowledgements stop (see BlobTransfer).
+
+// With kCapLogTokens the device sends LOG_TOKEN [level, format id, arguments]
+// instead of CMD_LOG text. LOG_FORMATS asks for its table of format strings
+// (see LogFormats), which the host uses to render the tokens, and SET_LOG_LEVEL
+// makes it drop every log below a level before it reaches the wire. A device
+// that did not negotiate kCapLogTokens renders the same table into CMD_LOG.
+
+// --- Multi-drop buses ---
+// Several devices may share one line (e.g. an RS-485 bus) when every packet
+// names a drop address: the device a request is for, or the device answering.
+// A bus cannot be negotiated, since every device would answer the first PING at
+// once, so it runs in BusLinkConfig() from the first byte. PING then only settles
+// each device's optional commands, and devices never push telemetry (their
+// answers would collide). The host lets one device talk at a time.
+
+// Set in the command byte of a packet whose payload is compressed; no command uses the high bit
+constexpr uint8_t kCompressedFlag = 0x80;
+
+enum class Integrity : uint8_t {
+  kXor = 0,     // 1-byte XOR of the payload
+  kCrc16 = 1,   // CRC-16/CCITT-FALSE of header + payload
+  kCrc32c = 2,  // CRC-32C of header + payload
+};
+
+enum class Framing : uint8_t {
+  kStartByte = 0,  // packets located by kStartByte and the header length
+  kCobs = 1,       // COBS(header + payload + trailer) followed by a 0x00 delimiter
+};
+
+// Per-link settings agreed during negotiation
+struct LinkConfig {
+  Integrity integrity = Integrity::kXor;
+  Framing framing = Framing::kStartByte;
+  // Header carries a sequence byte after `length`: requests are numbered 1..255
+  // and the device echoes the number in everything it sends while answering
+  bool sequenced = false;
+  // Capability bits both ends offered; gates optional commands such as kReadChanges
+  uint16_t commonCapabilities = 0;
+  // Device's HashSchema() from the PING answer; 0 when it did not report one
+  uint64_t schemaHash = 0;
+  // Header carries the drop address after `length`, before any sequence byte (multi-drop buses)
+  bool addressed = false;
+
+  std::size_t headerSize() const { return sizeof(PacketHeader) + (addressed ? 1 : 0) + (sequenced ? 1 : 0); }
+  bool supports(uint16_t capability) const { return (commonCapabilities & capability) != 0; }
+
+  std::size_t trailerSize() const {
+    switch (integrity) {
+      case Integrity::kCrc16:
+        return 2;
+      case Integrity::kCrc32c:
+        return 4;
+      default:
+        return 1;
+    }
+  }
+};
+
+constexpr std::size_t kMaxHeaderSize = sizeof(PacketHeader) + 2;
+constexpr std::size_t kMaxTrailerSize = 4;
+
+// Fixed modes of a multi-drop bus: the strongest ones, since nothing is negotiated
+inline LinkConfig BusLinkConfig() {
+  LinkConfig config;
+  config.integrity = Integrity::kCrc32c;
+  config.framing = Framing::kCobs;
+  config.sequenced = true;
+  config.addressed = true;
+  return config;
+}
+
+// Strongest integrity mode both sides support
+inline Integrity SelectIntegrity(uint16_t hostCaps, uint16_t deviceCaps) {
+  uint16_t common = hostCaps & deviceCaps;
+  if (common & kCapCrc32c) return Integrity::kCrc32c;
+  if (common & kCapCrc16) return Integrity::kCrc16;
+  return Integrity::kXor;
+}
+
+inline Framing SelectFraming(uint16_t hostCaps, uint16_t deviceCaps) {
+  return (hostCaps & deviceCaps & kCapCobs) ? Framing::kCobs : Framing::kStartByte;
+}
+
+inline bool SelectSequenced(uint16_t hostCaps, uint16_t deviceCaps) {
+  return (hostCaps & deviceCaps & kCapSequence) != 0;
+}
+
+inline const char* IntegrityName(Integrity mode) {
+  switch (mode) {
+    case Integrity::kCrc16:
+      return "CRC-16";
+    case Integrity::kCrc32c:
+      return "CRC-32C";
+    default:
+      return "XOR";
+  }
+}
+
+// Fingerprint of a GET_SCHEMA payload (64-bit FNV-1a; never 0)
+inline uint64_t HashSchema(std::span<const uint8_t> payload) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (uint8_t b : payload) hash = (hash ^ b) * 0x100000001B3ull;
+  return hash ? hash : 1;
+}
+
+inline const char* FramingName(Framing framing) { return framing == Framing::kCobs ? "COBS" : "start byte"; }
+
+// Trailer value for one packet. `header` and `payload` need not be contiguous.
+inline uint32_t ComputeTrailer(Integrity mode, std::span<const uint8_t> header, std::span<const uint8_t> payload) {
+  switch (mode) {
+    case Integrity::kCrc16:
+      return Crc::Crc16Ccitt(payload, Crc::Crc16Ccitt(header));
+    case Integrity::kCrc32c:
+      return Crc::Crc32c(payload, Crc::Crc32c(header));
+    default:
+      return CalculateChecksum(payload);
+  }
+}
+
+// Trailers are little endian, trailerSize() bytes wide
+inline void StoreTrailer(const LinkConfig& link, uint32_t value, uint8_t* out) {
+  for (std::size_t i = 0; i < link.trailerSize(); i++) out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+inline uint32_t LoadTrailer(const LinkConfig& link, const uint8_t* in) {
+  uint32_t value = 0;
+  for (std::size_t i = 0; i < link.trailerSize(); i++) value |= static_cast<uint32_t>(in[i]) << (8 * i);
+  return value;
+}
+
 }  // namespace Protocol
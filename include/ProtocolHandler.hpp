@@ -1,39 +1,347 @@
 #pragma once
-#include <functional>
+#include <algorithm>
+#include <chrono>
 #include <memory>
+#include <span>
+#include <string>
 #include <vector>
-#include "DeviceParameter.hpp"
+#include "BlobTransfer.hpp"
 #include "ICommunication.hpp"
+#include "Lz.hpp"
+#include "PacketParser.hpp"
 #include "Protocol.hpp"
+#include "ProtocolMessages.hpp"
+#include "ProtocolViews.hpp"
+#include "RequestTracker.hpp"
+#include "TxQueue.hpp"
 
+// Framing, negotiation and TX batching for one link. Received packets are
+// handed to a visitor passed to update(); its handlers are bound at compile
+// time and see payloads as views into the RX buffer:
+//
+//   Master role (app):  any of onSchema / onValues / onChanges / onWriteAck /
+//                       onWriteAllAck / onLog / onTelemetry / onSchemaPage /
+//                       onValuePage / onLogFormats / onLogToken / onLogLevel
+//                       (see Protocol::Dispatch),
+//                       plus onLinkReady(const LinkConfig&),
+//                       onRequestComplete(const RequestTracker::Result&),
+//                       onRequestFailed(const RequestTracker::Result&),
+//                       onBlobProgress(const BlobTransfer::Stats&) and
+//                       onBlobDone(Protocol::Wire::BlobStatus)
+//   Slave role (device): onRequest(Command, std::span<const uint8_t>, uint8_t sequence)
+//                       receives every request, PING included; with a fourth
+//                       uint8_t parameter it also gets the drop address
+//
+// Schema, read and write requests go through a RequestTracker: they are sent as
+// the in-flight window allows, retried on timeout and reported once settled.
+//
+// On links that negotiated kCapCompression, compressed packets are expanded into
+// a reusable buffer before anyone sees them, and sendPacket() compresses payloads
+// of kMinCompressSize bytes or more whenever that makes them smaller.
+//
+// On a multi-drop bus each device gets its own handler, constructed on a shared
+// Bus with the device's address. The handler API is the same; the Bus files
+// received packets by address and decides whose requests go on the wire.
 class ProtocolHandler {
  public:
+  class Bus;
+
+  struct CompressionStats {
+    uint64_t packets = 0;    // compressed packets received
+    uint64_t wireBytes = 0;  // their payload bytes as received
+    uint64_t rawBytes = 0;   // and once expanded
+    uint64_t errors = 0;     // payloads that failed to expand (dropped)
+  };
+
   explicit ProtocolHandler(ICommunication* comm);
+  // The device at `address` on `bus`, which must outlive the handler
+  ProtocolHandler(Bus& bus, uint8_t address);
+  ~ProtocolHandler();
+
+  // Disable copy and move (a Bus keeps a pointer to each of its drops)
+  ProtocolHandler(const ProtocolHandler&) = delete;
+  ProtocolHandler& operator=(const ProtocolHandler&) = delete;
+
+  static constexpr int kNegotiationTimeoutMs = 1000;
+  static constexpr std::size_t kMinCompressSize = 64;  // below this the flag byte overhead rarely pays off
 
   // Master Methods (Requesting)
+  // Offers `capabilities` in a PING; the visitor's onLinkReady fires once the answer
+  // (or the timeout, for devices that never answer) settles the link configuration.
+  // The PING goes out in legacy framing, so a device left in other modes starts over.
+  // A bus drop never offers kCapTelemetry, and sends the PING when the bus allows.
+  void negotiate(uint16_t capabilities = Protocol::kAllCapabilities);
   void sendPing();
   void requestSchema();
   void requestAllValues();
-  void writeValue(uint8_t id, float value);
-  void writeString(uint8_t id, const std::string& value);
-  void writeAll(const std::vector<float>& values);
+  // Values changed after `sinceVersion` (0 = all), answered by onChanges
+  void requestChanges(uint32_t sinceVersion);
+  // requestChanges() when the device supports it, requestAllValues() otherwise
+  void refreshValues(uint32_t sinceVersion);
+  // Ids above 255 go out as WRITE_VALUE_WIDE, which needs a kCapPaged link
+  void writeValue(uint16_t id, float value);
+  void writeString(uint16_t id, const std::string& value);
+  // Rows [first, first + count) of a paged schema (onSchemaPage) or their values (onValuePage)
+  void requestSchemaPage(uint16_t first, uint8_t count);
+  void requestValuePage(uint16_t first, uint8_t count);
+  // One transaction: the device applies every entry or none and answers once (onWriteAllAck)
+  void writeAll(const Protocol::WriteBatch& batch);
+  // Asks the device to push `ids` every `periodUs` as TELEMETRY batches (onTelemetry);
+  // subscribing an id again changes its period
+  void subscribe(std::span<const uint8_t> ids, uint32_t periodUs);
+  // Stops pushing `ids`; an empty list cancels every subscription
+  void unsubscribe(std::span<const uint8_t> ids = {});
+  // The device's table of log format strings (onLogFormats), for rendering LOG_TOKENs
+  void requestLogFormats();
+  // Asks the device to send only logs of `minLevel` and up (onLogLevel); kCapLogTokens links
+  void setLogLevel(uint8_t minLevel);
+  // Streams `data` into the device's blob `slot` (kCapBlob): BLOB_OPEN, a sliding
+  // window of CHUNKs, then BLOB_COMMIT, reported through onBlobProgress and
+  // onBlobDone. `data` (e.g. a MappedFile) must stay valid until onBlobDone. A
+  // device still holding the start of the same blob resumes after it. False
+  // (logged) when the link lacks kCapBlob or a transfer is already running.
+  bool sendBlob(uint8_t slot, std::span<const uint8_t> data);
+  // Stops sending without telling the device, which keeps what it has for a resume
+  void cancelBlob() { blob.finish(); }
+  const BlobTransfer::Stats& blobStats() const { return blob.stats(); }
+  bool isSendingBlob() const { return blob.active(); }
 
   // General Methods
-  void sendPacket(Protocol::Command cmd, const std::vector<uint8_t>& payload = {});
-  void update();
+  // Untracked send; a device passes the sequence of the request it is answering
+  // and, on an addressed link, the address it answers for (otherwise this handler's)
+  void sendPacket(Protocol::Command cmd, std::span<const uint8_t> payload = {}, uint8_t sequence = 0);
+  void sendPacket(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence, uint8_t fromAddress);
+  template <typename Visitor>
+  void update(Visitor& visitor);
+  // Pushes every packet queued since the last flush out in one write
+  void flush();
+  // Shared by every drop of a bus
+  const TxQueue::Stats& txStats() const { return line->txQueue.stats(); }
+  const PacketParser::Stats& rxStats() const { return line->rxParser.stats(); }
+  const RequestTracker::Stats& requestStats() const { return requests.stats(); }
+  const CompressionStats& compressionStats() const { return rxCompression; }
+  // Maximum requests awaiting an answer at once (RequestTracker::kDefaultWindow)
+  void setWindow(std::size_t requestCount) { requests.setWindow(requestCount); }
+
+  // Switches both directions; packets already queued keep their framing. A bus
+  // drop only takes the capabilities: its framing is the bus's.
+  void setLinkConfig(const Protocol::LinkConfig& config);
+  const Protocol::LinkConfig& getLinkConfig() const { return linkConfig; }
+  bool isNegotiating() const { return negotiating; }
+  uint8_t getAddress() const { return address; }
+
+ private:
+  // The wire: owned by a point-to-point handler, shared by the drops of a Bus
+  struct Line {
+    explicit Line(ICommunication* comm) : comm(comm), txQueue(comm) {}
+    ICommunication* comm;
+    PacketParser rxParser;
+    TxQueue txQueue;
+  };
 
-  // Callbacks for Master Role (UI)
-  std::function<void(const std::vector<DeviceParameter>&)> onSchemaReceived;
-  std::function<void(const std::vector<std::pair<uint8_t, float>>&)> onValuesReceived;
-  std::function<void(uint8_t)> onWriteAck;
-  std::function<void(uint8_t level, const std::string& msg)> onLogReceived;
+  // A packet the bus filed for this drop, in `filedBytes`
+  struct Filed {
+    Protocol::Command command;
+    uint8_t sequence;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  template <typename Visitor>
+  void handlePacket(PacketParser::Packet& packet, Visitor& visitor);
+  template <typename Visitor>
+  void finishNegotiation(const Protocol::LinkConfig& config, Visitor& visitor);
+
+  // What a blob answer, stall or failure means for the visitor
+  enum class BlobEvent : uint8_t { kNone, kProgress, kDone };
+  template <typename Visitor>
+  void reportBlob(BlobEvent event, Protocol::Wire::BlobStatus status, Visitor& visitor);
+  // Non-template halves of the blob transfer, kept out of the header
+  BlobEvent advanceBlob(Protocol::Command cmd, std::span<const uint8_t> payload, Protocol::Wire::BlobStatus& status);
+  BlobEvent checkBlob(RequestTracker::Clock::time_point now);
+  BlobEvent blobRequestFailed(const RequestTracker::Result& failed);
+  // Writes one CHUNK straight from the blob into the TX queue; false when it is full
+  bool sendChunk(uint32_t offset, std::span<const uint8_t> bytes);
+  // False (logged) for an id that needs WRITE_VALUE_WIDE on a link without it
+  bool canAddress(uint16_t id) const;
+  // Non-template halves of the negotiation, kept out of the header
+  bool parsePingAnswer(std::span<const uint8_t> payload, Protocol::LinkConfig& config);
+  bool negotiationTimedOut();
+  void applyNegotiated(const Protocol::LinkConfig& config);
+  // Slave side: a host started over with a legacy-framed PING; answer it in kind
+  void restartLegacy();
+  void submitRequest(Protocol::Command cmd, std::span<const uint8_t> payload);
+  // Puts every request that is due on the wire, or lets the bus decide
+  void sendRequests();
+  // Sends the capability PING and starts waiting for its answer
+  void sendOffer();
+  // Sends what is due, admitting at most `newRequests` requests not sent before
+  // (retries always go); returns how many of those it sent. Bus grants use it too.
+  std::size_t transmit(std::size_t newRequests);
+  // Bus scheduling: something to send, and answers still to come
+  bool hasWork(RequestTracker::Clock::time_point now) const;
+  bool awaitingAnswers() const { return negotiating || requests.stats().inFlight > 0 || blob.inFlight(); }
+  // Replaces a compressed packet's payload by its expansion; false if it is corrupt
+  bool expand(PacketParser::Packet& packet);
+
+  std::unique_ptr<Line> ownLine;  // null on a bus
+  Line* line;
+  Bus* bus = nullptr;
+  uint8_t address = 0;  // sent in every packet on addressed links
+  Protocol::LinkConfig linkConfig;
+  std::vector<Filed> filed;
+  std::vector<uint8_t> filedBytes;
+  bool pingQueued = false;  // bus drops: negotiate() waits for the line
+  RequestTracker requests;
+  BlobTransfer blob;
+  uint16_t offeredCapabilities = 0;
+  Lz::Encoder compressor;
+  std::vector<uint8_t> deflated;  // TX scratch
+  std::vector<uint8_t> inflated;  // expanded RX payload; valid while its packet is handled
+  CompressionStats rxCompression;
+  bool negotiating = false;
+  std::chrono::steady_clock::time_point negotiationStart;
+};
+
+// One line shared by several devices (a multi-drop bus). Each device is a
+// ProtocolHandler constructed on the bus, called a drop here. Every packet
+// carries the address of the drop it is for or from, and the bus runs in fixed
+// modes (Protocol::BusLinkConfig) since it cannot negotiate them.
+//
+// Devices share the return path, so only one may be answering at any time.
+// The bus grants the line to one drop at a time: that drop sends up to burst()
+// new requests back to back (plus any retries it has due), and once all of its
+// answers are in the line goes straight to the next drop with work, round robin.
+// Requests to different devices thus follow each other without idle polling
+// rounds, and no drop can hold the line for longer than one burst.
+//
+// Drops drive the bus from their own update(): the first to run reads the line
+// and files each packet with its drop, and every drop then handles its own.
+class ProtocolHandler::Bus {
+ public:
+  struct Stats {
+    uint64_t grants = 0;        // times the line passed to a drop
+    uint64_t strayPackets = 0;  // from addresses no drop is constructed for
+  };
 
-  // Callbacks for Slave Role (Simulator/Device)
-  std::function<void(Protocol::Command, const std::vector<uint8_t>&)> onCommandReceived;
+  static constexpr std::size_t kDefaultBurst = 8;
+
+  explicit Bus(ICommunication* comm, const Protocol::LinkConfig& config = Protocol::BusLinkConfig());
+
+  // Disable copy (drops point at the bus)
+  Bus(const Bus&) = delete;
+  Bus& operator=(const Bus&) = delete;
+
+  // New requests a drop may send per grant; 1 suits a two-wire (half-duplex) bus,
+  // where the host must not talk over a device
+  void setBurst(std::size_t requests) { burst = std::max<std::size_t>(requests, 1); }
+  std::size_t getBurst() const { return burst; }
+  const Protocol::LinkConfig& getLinkConfig() const { return line.rxParser.getLinkConfig(); }
+  const Stats& stats() const { return counters; }
 
  private:
-  void processPacket(const Protocol::PacketHeader& header, const std::vector<uint8_t>& payload);
+  friend class ProtocolHandler;
 
-  ICommunication* comm;
-  std::vector<uint8_t> rxBuffer;
+  void attach(ProtocolHandler* drop);
+  void detach(ProtocolHandler* drop);
+  // Reads everything the transport has and files each packet with its drop
+  void poll();
+  // Passes the line on once its holder has all its answers, and lets the holder send
+  void schedule();
+  // The holder keeps the line until one RTO after it last sent or was heard from
+  void extendHold(RequestTracker::Clock::time_point now);
+
+  Line line;
+  std::vector<ProtocolHandler*> drops;
+  ProtocolHandler* holder = nullptr;  // drop whose answers the line is waiting for
+  std::size_t nextDrop = 0;           // round-robin cursor into `drops`
+  std::size_t burst = kDefaultBurst;
+  std::size_t grantLeft = 0;  // new requests the holder may still send
+  RequestTracker::Clock::time_point holdUntil;
+  Stats counters;
 };
+
+template <typename Visitor>
+void ProtocolHandler::update(Visitor& visitor) {
+  if (!line->comm || !line->comm->isOpen()) return;
+
+  if (bus) {
+    // Everything this drop was sent, filed by whichever drop read the line first
+    bus->poll();
+    for (const Filed& f : filed) {
+      PacketParser::Packet packet{f.command, {filedBytes.data() + f.offset, f.size}, f.sequence, address};
+      handlePacket(packet, visitor);
+    }
+    filed.clear();
+    filedBytes.clear();
+  } else {
+    // Drain everything the transport has buffered since the last frame, reading
+    // straight into the parser's buffer and handling packets as they complete
+    PacketParser::Packet packet;
+    while (true) {
+      std::size_t n = line->comm->read(line->rxParser.writeSpace());
+      line->rxParser.commit(n);
+      while (line->rxParser.next(packet)) handlePacket(packet, visitor);
+      if (n == 0) break;
+    }
+  }
+
+  if (negotiationTimedOut()) finishNegotiation({}, visitor);
+
+  RequestTracker::Result failed;
+  while (requests.expire(RequestTracker::Clock::now(), failed)) {
+    if constexpr (requires { visitor.onRequestFailed(failed); }) visitor.onRequestFailed(failed);
+    reportBlob(blobRequestFailed(failed), Protocol::Wire::BlobStatus::kNoAnswer, visitor);
+  }
+  reportBlob(checkBlob(RequestTracker::Clock::now()), Protocol::Wire::BlobStatus::kNoAnswer, visitor);
+  sendRequests();
+
+  // Replies queued by the handlers above go out together
+  line->txQueue.flush();
+}
+
+template <typename Visitor>
+void ProtocolHandler::handlePacket(PacketParser::Packet& packet, Visitor& visitor) {
+  if (!expand(packet)) return;
+  if constexpr (requires { visitor.onRequest(packet.command, packet.payload, packet.sequence, packet.address); }) {
+    // Slave mode serving a bus: the visitor answers for the addresses it simulates
+    if (packet.legacy) restartLegacy();
+    visitor.onRequest(packet.command, packet.payload, packet.sequence, packet.address);
+  } else if constexpr (requires { visitor.onRequest(packet.command, packet.payload, packet.sequence); }) {
+    // Slave mode (simulator): the payload is a request, not a response
+    if (packet.legacy) restartLegacy();
+    visitor.onRequest(packet.command, packet.payload, packet.sequence);
+  } else if (packet.command == Protocol::Command::kPing) {
+    Protocol::LinkConfig config;
+    if (parsePingAnswer(packet.payload, config)) finishNegotiation(config, visitor);
+  } else {
+    RequestTracker::Result result;
+    auto now = RequestTracker::Clock::now();
+    auto match = requests.settle(packet.command, packet.sequence, packet.payload, now, result);
+    if (match == RequestTracker::Match::kStale) return;  // answer to a retry we no longer need
+    if constexpr (requires { visitor.onRequestComplete(result); }) {
+      if (match == RequestTracker::Match::kSettled) visitor.onRequestComplete(result);
+    }
+    Protocol::Wire::BlobStatus status{};
+    if (BlobEvent event = advanceBlob(packet.command, packet.payload, status); event != BlobEvent::kNone) {
+      reportBlob(event, status, visitor);
+      return;
+    }
+    Protocol::Dispatch(packet.command, packet.payload, visitor);
+  }
+}
+
+template <typename Visitor>
+void ProtocolHandler::reportBlob(BlobEvent event, Protocol::Wire::BlobStatus status, Visitor& visitor) {
+  if (event == BlobEvent::kProgress) {
+    if constexpr (requires { visitor.onBlobProgress(blob.stats()); }) visitor.onBlobProgress(blob.stats());
+  } else if (event == BlobEvent::kDone) {
+    if constexpr (requires { visitor.onBlobDone(status); }) visitor.onBlobDone(status);
+  }
+}
+
+template <typename Visitor>
+void ProtocolHandler::finishNegotiation(const Protocol::LinkConfig& config, Visitor& visitor) {
+  applyNegotiated(config);
+  if constexpr (requires { visitor.onLinkReady(config); }) visitor.onLinkReady(config);
+}
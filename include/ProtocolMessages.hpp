@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "Protocol.hpp"
+
+// Payload layouts, declared once as a list of fields and shared by the host,
+// the simulator and the mock. Each Message generates a size-checked encoder and
+// decoder; a message made only of fixed-size fields is checked once and then
+// compiles down to straight loads and stores at constant offsets.
+//
+//   uint8_t out[Wire::NumericValue::kSize];
+//   Wire::NumericValue::encode(out, id, value);
+//   if (Wire::NumericValue::decode(payload, offset, id, value)) ...
+namespace Protocol::Wire {
+
+// A little endian scalar (every supported target is little endian)
+template <typename T>
+struct Scalar {
+  using Type = T;
+  static constexpr std::size_t kFixedSize = sizeof(T);
+
+  static constexpr std::size_t size(const T&) { return sizeof(T); }
+  static uint8_t* store(uint8_t* out, const T& v) {
+    std::memcpy(out, &v, sizeof(T));
+    return out + sizeof(T);
+  }
+  // Unchecked; the message checked the whole fixed block already
+  static const uint8_t* load(const uint8_t* in, T& v) {
+    std::memcpy(&v, in, sizeof(T));
+    return in + sizeof(T);
+  }
+  static bool load(std::span<const uint8_t> in, std::size_t& offset, T& v) {
+    if (in.size() - offset < sizeof(T)) return false;
+    load(in.data() + offset, v);
+    offset += sizeof(T);
+    return true;
+  }
+};
+
+// [length u8][bytes]; longer strings are cut to 255 bytes. Decodes to a view into the payload.
+struct Str8 {
+  using Type = std::string_view;
+  static constexpr std::size_t kFixedSize = 0;  // variable
+
+  static constexpr std::size_t size(std::string_view v) { return 1 + std::min<std::size_t>(v.size(), 255); }
+  static uint8_t* store(uint8_t* out, std::string_view v) {
+    std::size_t len = std::min<std::size_t>(v.size(), 255);
+    *out++ = static_cast<uint8_t>(len);
+    std::memcpy(out, v.data(), len);
+    return out + len;
+  }
+  static bool load(std::span<const uint8_t> in, std::size_t& offset, std::string_view& v) {
+    if (offset >= in.size() || in[offset] > in.size() - offset - 1) return false;
+    v = std::string_view(reinterpret_cast<const char*>(&in[offset + 1]), in[offset]);
+    offset += 1 + in[offset];
+    return true;
+  }
+};
+
+using U8 = Scalar<uint8_t>;
+using U16 = Scalar<uint16_t>;
+using U32 = Scalar<uint32_t>;
+using U64 = Scalar<uint64_t>;
+using F32 = Scalar<float>;
+
+template <typename... Fields>
+struct Message {
+  static constexpr bool kFixed = ((Fields::kFixedSize != 0) && ...);
+  // Exact size of a fixed message; the smallest possible encoding otherwise
+  static constexpr std::size_t kSize = ((Fields::kFixedSize != 0 ? Fields::kFixedSize : 1) + ...);
+
+  static constexpr std::size_t size(const typename Fields::Type&... values) { return (Fields::size(values) + ...); }
+
+  // Writes the fields to `out`, which must hold size(values...); returns the end
+  static uint8_t* encode(uint8_t* out, const typename Fields::Type&... values) {
+    ((out = Fields::store(out, values)), ...);
+    return out;
+  }
+  // Appends the encoded fields
+  static void append(std::vector<uint8_t>& out, const typename Fields::Type&... values) {
+    std::size_t at = out.size();
+    out.resize(at + size(values...));
+    encode(out.data() + at, values...);
+  }
+
+  // Reads the fields at `offset` and moves it past them; false (with `offset`
+  // unchanged) when the payload ends first
+  static bool decode(std::span<const uint8_t> in, std::size_t& offset, typename Fields::Type&... values) {
+    if (offset > in.size()) return false;
+    if constexpr (kFixed) {
+      if (in.size() - offset < kSize) return false;
+      const uint8_t* p = in.data() + offset;
+      ((p = Fields::load(p, values)), ...);
+      offset += kSize;
+      return true;
+    } else {
+      std::size_t at = offset;
+      if (!(Fields::load(in, at, values) && ...)) return false;
+      offset = at;
+      return true;
+    }
+  }
+};
+
+// --- Layouts (see docs/PROTOCOL.md) ---
+using PingOffer = Message<U8, U8, U8>;                // [version, capabilities, extended capabilities]
+using SchemaEntry = Message<U8, U8, Str8, F32, F32>;  // {id, type, name, min, max}
+using NumericValue = Message<U8, F32>;                // value entry / WRITE_VALUE for numbers
+using StringValue = Message<U8, Str8>;                // value entry / WRITE_VALUE for strings
+using ParamId = Message<U8>;                          // WRITE_VALUE ack
+using Count = Message<U8>;                            // list prefix
+using Version = Message<U32>;                         // READ_CHANGES request and response prefix
+using TelemetryHeader = Message<U32>;                 // time of the first sample
+using SubscribeHeader = Message<U32, U8>;             // [period us, count] then ids
+using WriteAllAck = Message<U8, U8, U8>;              // [WriteAllStatus, count, first rejected entry]
+using SchemaHash = Message<U64>;                      // PING answer tail, after the framing byte
+using PingExtension = Message<U8>;                    // extended capabilities, after the schema hash
+
+// Paged transfers (kCapPaged)
+using PageRequest = Message<U16, U8>;                      // [first row, row count]
+using SchemaPageHeader = Message<U16, U16>;                // [total rows, first row], then Count and WideSchemaEntry
+using ValuePageHeader = Message<U16>;                      // [first row], then Count and wide value entries
+using WideSchemaEntry = Message<U16, U8, Str8, F32, F32>;  // {id, type, name, min, max}
+using WideNumericValue = Message<U16, F32>;                // value entry / WRITE_VALUE_WIDE for numbers
+using WideStringValue = Message<U16, Str8>;                // value entry / WRITE_VALUE_WIDE for strings
+using WideParamId = Message<U16>;                          // WRITE_VALUE_WIDE ack
+
+// Blob transfers (kCapBlob)
+using BlobOpen = Message<U8, U32, U32>;          // [slot, total bytes, CRC-32C of the blob]
+using BlobOpenAck = Message<U8, U32, U16, U8>;   // [BlobStatus, resume offset, max chunk bytes, window chunks]
+using BlobChunkHeader = Message<U32>;            // offset, then the bytes
+using BlobChunkAck = Message<U32>;               // bytes received in order so far
+using BlobCommitAck = Message<U8>;               // BlobStatus
+
+// Tokenized logs (kCapLogTokens)
+using LogFormatEntry = Message<U8, Str8>;  // LOG_FORMATS entry: {format id, format string}
+using LogTokenHeader = Message<U8, U8>;    // [level, format id], then the arguments
+using LogLevel = Message<U8>;              // SET_LOG_LEVEL request and answer: lowest level sent
+
+enum class WriteAllStatus : uint8_t {
+  kCommitted = 0,  // every entry was applied
+  kRejected = 1,   // none was; the ack names the first entry that failed
+};
+
+enum class BlobStatus : uint8_t {
+  kOk = 0,
+  kBadSlot = 1,      // the device has no such slot
+  kTooLarge = 2,     // the blob does not fit the slot
+  kIncomplete = 3,   // COMMIT before every byte arrived
+  kBadCrc = 4,       // the bytes received do not match the CRC from BLOB_OPEN; the device discards them
+  kNoTransfer = 5,   // CHUNK or COMMIT without a BLOB_OPEN
+  kNoAnswer = 0xFF,  // host side only: the device stopped answering
+};
+
+inline const char* BlobStatusName(BlobStatus status) {
+  switch (status) {
+    case BlobStatus::kOk:
+      return "done";
+    case BlobStatus::kBadSlot:
+      return "no such slot";
+    case BlobStatus::kTooLarge:
+      return "too large for the slot";
+    case BlobStatus::kIncomplete:
+      return "incomplete";
+    case BlobStatus::kBadCrc:
+      return "CRC mismatch";
+    case BlobStatus::kNoTransfer:
+      return "no transfer open";
+    case BlobStatus::kNoAnswer:
+      return "no answer";
+  }
+  return "unknown status";
+}
+
+static_assert(NumericValue::kFixed && NumericValue::kSize == 5, "value entries are 5 bytes on the wire");
+static_assert(SubscribeHeader::kSize == 5 && !SchemaEntry::kFixed);
+
+}  // namespace Protocol::Wire
+
+namespace Protocol {
+
+// A CMD_WRITE_ALL payload under construction: Wire::Count, then one value entry
+// per parameter laid out by its type, as in READ_ALL
+class WriteBatch {
+ public:
+  static constexpr std::size_t kMaxEntries = 255;
+  static constexpr std::size_t kMaxBytes = 4096;
+
+  WriteBatch() { clear(); }
+
+  // false (leaving the batch as it was) once it is full
+  bool add(uint8_t id, float value) {
+    if (!fits(Wire::NumericValue::kSize)) return false;
+    Wire::NumericValue::append(bytes, id, value);
+    bytes[0]++;
+    return true;
+  }
+  bool add(uint8_t id, std::string_view text) {
+    if (!fits(Wire::StringValue::size(id, text))) return false;
+    Wire::StringValue::append(bytes, id, text);
+    bytes[0]++;
+    return true;
+  }
+
+  std::size_t count() const { return bytes[0]; }
+  bool empty() const { return count() == 0; }
+  std::span<const uint8_t> payload() const { return bytes; }
+  void clear() { bytes.assign(1, 0); }
+
+ private:
+  bool fits(std::size_t entrySize) const { return count() < kMaxEntries && bytes.size() + entrySize <= kMaxBytes; }
+
+  std::vector<uint8_t> bytes;
+};
+
+}  // namespace Protocol
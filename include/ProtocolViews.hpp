@@ -0,0 +1,290 @@
+#pragma once
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include "Protocol.hpp"
+#include "ProtocolMessages.hpp"
+
+// Zero-copy views over received payloads. Entries are decoded one at a time
+// while iterating, straight out of the parser's buffer; nothing is allocated.
+// Truncated or malformed input simply ends the iteration early.
+namespace Protocol {
+
+struct SchemaEntry {
+  uint16_t id = 0;  // 8 bits except in paged transfers
+  ParamType type = ParamType::kToggle;
+  std::string_view name;
+  float min = 0.0f;
+  float max = 0.0f;
+};
+
+struct ValueEntry {
+  uint16_t id = 0;
+  float value = 0.0f;
+  std::string_view text;  // the value of a string parameter
+};
+
+struct LogFormatEntry {
+  uint8_t id = 0;
+  std::string_view format;
+};
+
+// CMD_WRITE_ALL answer (Wire::WriteAllAck)
+struct WriteAllResult {
+  Wire::WriteAllStatus status = Wire::WriteAllStatus::kRejected;
+  uint8_t count = 0;          // entries in the batch
+  uint8_t rejectedEntry = 0;  // first entry that failed; `count` when committed
+
+  bool committed() const { return status == Wire::WriteAllStatus::kCommitted; }
+};
+
+// Parameter type by id, from the schema. Value entries are laid out by type, so
+// a list holding string values can only be decoded with the table at hand.
+using ValueTypes = std::array<ParamType, 65536>;
+
+// Schema entries laid out as `Layout`, whose first field is the id
+template <typename IdField, typename Layout>
+struct BasicSchemaDecoder {
+  using Entry = SchemaEntry;
+  bool decode(std::span<const uint8_t> p, std::size_t& offset, Entry& e) const {
+    typename IdField::Type id;
+    uint8_t type;
+    if (!Layout::decode(p, offset, id, type, e.name, e.min, e.max)) return false;
+    e.id = id;
+    e.type = static_cast<ParamType>(type);
+    return true;
+  }
+};
+
+// Value entries: `Numeric`, or `String` for string parameters. Without `types`
+// every entry is taken as numeric.
+template <typename IdField, typename Numeric, typename String>
+struct BasicValueDecoder {
+  using Entry = ValueEntry;
+  const ValueTypes* types = nullptr;
+
+  bool decode(std::span<const uint8_t> p, std::size_t& offset, Entry& e) const {
+    typename IdField::Type id;
+    std::size_t at = offset;
+    if (!IdField::load(p, at, id)) return false;
+    bool ok;
+    if (types && (*types)[id] == ParamType::kString) {
+      e.value = 0.0f;
+      ok = String::decode(p, offset, id, e.text);
+    } else {
+      e.text = {};
+      ok = Numeric::decode(p, offset, id, e.value);
+    }
+    e.id = id;
+    return ok;
+  }
+};
+
+// GET_SCHEMA response: [count] then Wire::SchemaEntry
+using SchemaDecoder = BasicSchemaDecoder<Wire::U8, Wire::SchemaEntry>;
+// READ_ALL response: [count] then Wire::NumericValue / Wire::StringValue
+using ValueDecoder = BasicValueDecoder<Wire::U8, Wire::NumericValue, Wire::StringValue>;
+// Paged lists (after their page header): 16-bit ids
+using WideSchemaDecoder = BasicSchemaDecoder<Wire::U16, Wire::WideSchemaEntry>;
+using WideValueDecoder = BasicValueDecoder<Wire::U16, Wire::WideNumericValue, Wire::WideStringValue>;
+
+// LOG_FORMATS response: [count] then Wire::LogFormatEntry
+struct LogFormatDecoder {
+  using Entry = LogFormatEntry;
+  bool decode(std::span<const uint8_t> p, std::size_t& offset, Entry& e) const {
+    return Wire::LogFormatEntry::decode(p, offset, e.id, e.format);
+  }
+};
+
+// A count-prefixed list of variable-size entries, decoded lazily by `Decoder`
+template <typename Decoder>
+class CountedView {
+ public:
+  using Entry = typename Decoder::Entry;
+
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Entry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Entry*;
+    using reference = const Entry&;
+
+    iterator() = default;
+    iterator(std::span<const uint8_t> data, std::size_t count, Decoder decoder)
+        : data(data), remaining(count), decoder(decoder) {
+      advance();
+    }
+
+    reference operator*() const { return entry; }
+    pointer operator->() const { return &entry; }
+    iterator& operator++() {
+      advance();
+      return *this;
+    }
+    void operator++(int) { advance(); }
+    bool operator==(std::default_sentinel_t) const { return done; }
+
+   private:
+    void advance() {
+      done = remaining == 0 || !decoder.decode(data, offset, entry);
+      if (!done) remaining--;
+    }
+
+    std::span<const uint8_t> data;
+    std::size_t offset = 1;  // past the count byte
+    std::size_t remaining = 0;
+    Decoder decoder{};
+    Entry entry{};
+    bool done = true;
+  };
+
+  explicit CountedView(std::span<const uint8_t> payload, Decoder decoder = {}) : payload(payload), decoder(decoder) {}
+
+  // Entry count announced by the sender; iteration may yield fewer if truncated
+  std::size_t declaredCount() const { return payload.empty() ? 0 : payload[0]; }
+  // The whole payload, count byte included
+  std::span<const uint8_t> bytes() const { return payload; }
+  iterator begin() const { return iterator(payload, declaredCount(), decoder); }
+  std::default_sentinel_t end() const { return {}; }
+
+ private:
+  std::span<const uint8_t> payload;
+  Decoder decoder;
+};
+
+using SchemaView = CountedView<SchemaDecoder>;
+using ValueListView = CountedView<ValueDecoder>;
+using SchemaPageView = CountedView<WideSchemaDecoder>;
+using ValuePageView = CountedView<WideValueDecoder>;
+using LogFormatsView = CountedView<LogFormatDecoder>;
+
+// Decodes value lists with the visitor's type table when it has one
+template <typename Decoder = ValueDecoder, typename Visitor>
+Decoder ValueDecoderFor(Visitor& visitor) {
+  if constexpr (requires { { visitor.valueTypes() } -> std::convertible_to<const ValueTypes&>; }) {
+    return {&visitor.valueTypes()};
+  } else {
+    return {};
+  }
+}
+
+// Routes one response to whichever handlers `visitor` defines:
+//   onSchema(SchemaView), onValues(ValueListView), onWriteAck(uint8_t id),
+//   onChanges(uint32_t version, ValueListView), onLog(uint8_t level, std::string_view message),
+//   onTelemetry(uint32_t timeUs, ValueListView), onWriteAllAck(const WriteAllResult&),
+//   onSchemaPage(uint16_t totalRows, uint16_t firstRow, SchemaPageView),
+//   onValuePage(uint16_t firstRow, ValuePageView), onLogFormats(LogFormatsView),
+//   onLogToken(uint8_t level, uint8_t format, std::span<const uint8_t> args),
+//   onLogLevel(uint8_t minLevel)
+// onWriteAck also receives WRITE_VALUE_WIDE acks, hence the 16-bit id.
+// Missing handlers are resolved at compile time; the command is then ignored.
+// A visitor with `const ValueTypes& valueTypes()` also gets string values decoded.
+template <typename Visitor>
+void Dispatch(Command cmd, std::span<const uint8_t> payload, Visitor& visitor) {
+  std::size_t offset = 0;
+  switch (cmd) {
+    case Command::kGetSchema:
+      if constexpr (requires { visitor.onSchema(SchemaView(payload)); }) {
+        if (!payload.empty()) visitor.onSchema(SchemaView(payload));
+      }
+      break;
+    case Command::kReadAll:
+      if constexpr (requires { visitor.onValues(ValueListView(payload)); }) {
+        if (!payload.empty()) visitor.onValues(ValueListView(payload, ValueDecoderFor(visitor)));
+      }
+      break;
+    case Command::kReadChanges:
+      // Wire::Version followed by a READ_ALL style list of the values changed since the requested version
+      if constexpr (requires { visitor.onChanges(uint32_t{}, ValueListView(payload)); }) {
+        uint32_t version;
+        if (Wire::Version::decode(payload, offset, version) && offset < payload.size()) {
+          visitor.onChanges(version, ValueListView(payload.subspan(offset), ValueDecoderFor(visitor)));
+        }
+      }
+      break;
+    case Command::kWriteValue:
+      if constexpr (requires { visitor.onWriteAck(uint16_t{}); }) {
+        uint8_t id;
+        if (Wire::ParamId::decode(payload, offset, id)) visitor.onWriteAck(id);
+      }
+      break;
+    case Command::kWriteValueWide:
+      if constexpr (requires { visitor.onWriteAck(uint16_t{}); }) {
+        uint16_t id;
+        if (Wire::WideParamId::decode(payload, offset, id)) visitor.onWriteAck(id);
+      }
+      break;
+    case Command::kGetSchemaPage:
+      if constexpr (requires { visitor.onSchemaPage(uint16_t{}, uint16_t{}, SchemaPageView(payload)); }) {
+        uint16_t total, first;
+        if (Wire::SchemaPageHeader::decode(payload, offset, total, first) && offset < payload.size()) {
+          visitor.onSchemaPage(total, first, SchemaPageView(payload.subspan(offset)));
+        }
+      }
+      break;
+    case Command::kReadValuePage:
+      if constexpr (requires { visitor.onValuePage(uint16_t{}, ValuePageView(payload)); }) {
+        uint16_t first;
+        if (Wire::ValuePageHeader::decode(payload, offset, first) && offset < payload.size()) {
+          auto decoder = ValueDecoderFor<WideValueDecoder>(visitor);
+          visitor.onValuePage(first, ValuePageView(payload.subspan(offset), decoder));
+        }
+      }
+      break;
+    case Command::kWriteAll:
+      if constexpr (requires { visitor.onWriteAllAck(WriteAllResult{}); }) {
+        WriteAllResult result;
+        uint8_t status;
+        if (Wire::WriteAllAck::decode(payload, offset, status, result.count, result.rejectedEntry)) {
+          result.status = static_cast<Wire::WriteAllStatus>(status);
+          visitor.onWriteAllAck(result);
+        }
+      }
+      break;
+    case Command::kLog:
+      if constexpr (requires { visitor.onLog(uint8_t{}, std::string_view{}); }) {
+        if (!payload.empty()) {
+          visitor.onLog(payload[0],
+                        std::string_view(reinterpret_cast<const char*>(payload.data() + 1), payload.size() - 1));
+        }
+      }
+      break;
+    case Command::kLogFormats:
+      if constexpr (requires { visitor.onLogFormats(LogFormatsView(payload)); }) {
+        if (!payload.empty()) visitor.onLogFormats(LogFormatsView(payload));
+      }
+      break;
+    case Command::kLogToken:
+      if constexpr (requires { visitor.onLogToken(uint8_t{}, uint8_t{}, payload); }) {
+        uint8_t level, format;
+        if (Wire::LogTokenHeader::decode(payload, offset, level, format)) {
+          visitor.onLogToken(level, format, payload.subspan(offset));
+        }
+      }
+      break;
+    case Command::kSetLogLevel:
+      if constexpr (requires { visitor.onLogLevel(uint8_t{}); }) {
+        uint8_t level;
+        if (Wire::LogLevel::decode(payload, offset, level)) visitor.onLogLevel(level);
+      }
+      break;
+    case Command::kTelemetry:
+      // Wire::TelemetryHeader followed by a READ_ALL style list of samples (numeric only)
+      if constexpr (requires { visitor.onTelemetry(uint32_t{}, ValueListView(payload)); }) {
+        uint32_t timeUs;
+        if (Wire::TelemetryHeader::decode(payload, offset, timeUs) && offset < payload.size()) {
+          visitor.onTelemetry(timeUs, ValueListView(payload.subspan(offset)));
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+}  // namespace Protocol
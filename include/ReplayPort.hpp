@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ICommunication.hpp"
+#include "LinkTrace.hpp"
+
+// Plays the RX side of a link trace back to the app. Opened with
+// "replay:<file>[?speed=<N>]": speed 1 (default) keeps the recorded timing,
+// N > 1 compresses it and 0 delivers as fast as ProtocolHandler can read.
+// Writes from the app are accepted and discarded.
+class ReplayPort : public ICommunication {
+ public:
+  static constexpr const char* kPrefix = "replay:";
+
+  struct Stats {
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t droppedTxBytes = 0;
+  };
+
+  explicit ReplayPort(double speed = 1.0) : speed(speed) {}
+
+  bool open(const std::string& port, int baudRate) override;
+  void close() override;
+  bool isOpen() const override { return reader.isOpen(); }
+  std::size_t read(std::span<uint8_t> buffer) override;
+  std::size_t write(std::span<const uint8_t> data) override;
+  std::vector<std::string> listPorts() override { return {}; }
+
+  void setSpeed(double newSpeed);
+  double getSpeed() const { return speed; }
+  bool finished() const { return done; }
+  const Stats& stats() const { return counters; }
+  const LinkTrace::Reader& getReader() const { return reader; }
+
+ private:
+  // Unthrottled replay ends a read burst after this many bytes, so one
+  // ProtocolHandler::update() never swallows the whole capture at once
+  static constexpr std::size_t kBurstBytes = 64 * 1024;
+
+  bool loadNext();
+  bool isDue(uint64_t timeNs) const;
+
+  LinkTrace::Reader reader;
+  double speed;
+  uint64_t cursor = 0;
+  LinkTrace::Record current;
+  std::size_t currentPos = 0;
+  bool haveCurrent = false;
+  bool done = false;
+  std::size_t burst = 0;
+  uint64_t originNs = 0;  // trace time that maps to `originTime`
+  std::chrono::steady_clock::time_point originTime;
+  Stats counters;
+};
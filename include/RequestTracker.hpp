@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Protocol.hpp"
+
+// Requests a link is waiting on. Each request holds a slot from a fixed pool
+// until its response arrives or it runs out of attempts; at most window() of
+// them are on the wire at once and the rest wait in issue order.
+//
+// Responses are matched by sequence id on sequenced links, otherwise by command
+// (and parameter id for writes), oldest first. The retransmit timeout follows
+// RFC 6298: it tracks the smoothed RTT, doubles with every retry of a request,
+// and retried requests give no RTT sample (Karn's rule).
+class RequestTracker {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    Protocol::Command command = Protocol::Command::kPing;
+    uint8_t sequence = 0;  // assigned when first sent; kept across retries
+    uint8_t attempts = 0;
+    uint64_t order = 0;  // issue order; 0 marks a free slot
+    Clock::time_point firstSent;
+    Clock::time_point deadline;
+    std::vector<uint8_t> payload;
+  };
+
+  // A settled request, as reported to the protocol visitor
+  struct Result {
+    Protocol::Command command;
+    uint8_t sequence;
+    std::span<const uint8_t> request;  // the request payload; valid during the call
+    uint8_t attempts;
+    uint32_t rttUs;  // first send to response; 0 for failures
+  };
+
+  struct Stats {
+    uint64_t issued = 0;
+    uint64_t completed = 0;
+    uint64_t retransmits = 0;
+    uint64_t failed = 0;
+    uint64_t stale = 0;  // answers to requests already settled
+    uint32_t lastRttUs = 0;
+    uint32_t srttUs = 0;  // 0 until the first sample
+    uint32_t rttvarUs = 0;
+    uint32_t rtoMs = 0;
+    uint32_t inFlight = 0;
+    uint32_t queued = 0;
+  };
+
+  enum class Match : uint8_t {
+    kUnrelated,  // not an answer to anything we track (logs, legacy extras)
+    kSettled,    // completed a request; `result` is filled in
+    kStale,      // duplicate answer to a request already settled; drop it
+  };
+
+  static constexpr std::size_t kMaxOutstanding = 256;  // queued + in flight
+  static constexpr std::size_t kMaxWindow = 64;         // well below the 255 sequence ids
+  static constexpr std::size_t kDefaultWindow = 8;
+  static constexpr uint8_t kMaxAttempts = 4;
+  static constexpr uint32_t kInitialRtoMs = 1000;
+  static constexpr uint32_t kMinRtoMs = 100;
+  static constexpr uint32_t kMaxRtoMs = 8000;
+
+  RequestTracker();
+
+  // Clamped to [1, kMaxWindow]; takes effect on the next nextToSend()
+  void setWindow(std::size_t requests);
+  std::size_t window() const { return windowSize; }
+  void setSequenced(bool on) { sequenced = on; }
+
+  // Commands that get an answer and are therefore worth tracking
+  static bool IsTracked(Protocol::Command cmd);
+
+  // Queues a request; false (after logging) when every slot is taken
+  bool submit(Protocol::Command cmd, std::span<const uint8_t> payload);
+  // Next request to put on the wire: timed-out ones due for a retry, then queued
+  // ones the window admits (unless `newRequests` is false). Marks it sent;
+  // returns nullptr when nothing is due.
+  const Request* nextToSend(Clock::time_point now, bool newRequests = true);
+  // Whether nextToSend(now) would return a request
+  bool hasDue(Clock::time_point now) const;
+  // Frees one request that timed out on its last attempt; false when there is none
+  bool expire(Clock::time_point now, Result& result);
+  // Settles the request a received packet answers
+  Match settle(Protocol::Command cmd, uint8_t sequence, std::span<const uint8_t> payload, Clock::time_point now,
+               Result& result);
+  // Drops everything outstanding, e.g. when the link is renegotiated
+  void clear();
+
+  const Stats& stats() const { return counters; }
+
+ private:
+  Request* findAnswered(Protocol::Command cmd, uint8_t sequence, std::span<const uint8_t> payload);
+  uint8_t allocateSequence();
+  void sampleRtt(uint32_t rttUs);
+  void release(Request& request, Result& result, uint32_t rttUs);
+
+  std::array<Request, kMaxOutstanding> slots;
+  std::size_t windowSize = kDefaultWindow;
+  bool sequenced = false;
+  uint64_t nextOrder = 1;
+  uint8_t lastSequence = 0;
+  uint32_t rtoMs = kInitialRtoMs;
+  Stats counters;
+};
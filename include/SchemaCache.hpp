@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include "MappedFile.hpp"
+
+// Schemas of devices seen before, keyed by the hash a device reports when it
+// negotiates (Protocol::LinkConfig::schemaHash), so reconnecting to a known
+// board skips the GET_SCHEMA transfer.
+//
+// One file per schema, <directory>/<hash as 16 hex digits>.schema: a
+// FileHeader, then the GET_SCHEMA payload as the device sent it. A hit is
+// mapped read-only and decoded in place by Protocol::SchemaView, exactly like a
+// payload fresh off the wire. All integers are little endian.
+class SchemaCache {
+ public:
+#pragma pack(push, 1)
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t length;  // payload bytes that follow
+    uint64_t hash;    // Protocol::HashSchema of the payload
+  };
+#pragma pack(pop)
+
+  static constexpr char kMagic[8] = {'Z', 'A', 'S', 'C', 'H', 'E', 'M', 'A'};
+  static constexpr uint32_t kVersion = 1;
+
+  // A mapped cache file; the payload stays valid while the Entry lives
+  class Entry {
+   public:
+    explicit operator bool() const { return file.isOpen(); }
+    std::span<const uint8_t> payload() const;
+
+   private:
+    friend class SchemaCache;
+
+    MappedFile file;
+  };
+
+  // $XDG_CACHE_HOME/zonaianvil/schemas, or ~/.cache/zonaianvil/schemas; empty
+  // (caching off) when neither variable is set
+  static std::string DefaultDirectory();
+
+  explicit SchemaCache(std::string directory = DefaultDirectory());
+
+  // Maps the schema stored under `hash`; empty when there is none or the file
+  // is damaged (bad header, truncated, or contents not matching the hash)
+  Entry find(uint64_t hash) const;
+  // Saves a GET_SCHEMA payload whose hash is `hash`. Written to a temporary file
+  // and renamed, so a concurrent find() never sees half an entry.
+  bool store(uint64_t hash, std::span<const uint8_t> payload) const;
+
+  const std::string& directory() const { return dir; }
+
+ private:
+  std::string pathFor(uint64_t hash) const;
+
+  std::string dir;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Protocol.hpp"
+
+struct SimulatedParam {
+  uint16_t id;  // above 255 only reachable on kCapPaged links
+  uint8_t type;
+  std::string name;
+  float value;
+  float min;
+  float max;
+  std::string stringValue;
+  uint32_t version = 0;  // device change counter when this value last changed
+};
+
+// Device side of the protocol. Shared by MockSerialPort (in-process) and the
+// ZonaiAnvilSim PTY simulator so both answer requests identically.
+class SimulatedDevice {
+ public:
+  using Responder = std::function<void(Protocol::Command, std::span<const uint8_t>)>;
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr uint32_t kMinPeriodUs = 100;  // fastest rate a subscription gets: 10 kHz
+  static constexpr std::size_t kMaxBatchSamples = 200;  // samples per TELEMETRY packet (1 KiB of entries)
+  static constexpr auto kBatchInterval = std::chrono::milliseconds(10);  // oldest sample a batch may hold back
+  static constexpr auto kMaxLag = std::chrono::milliseconds(100);  // samples older than this are skipped
+  static constexpr std::size_t kMaxPageBytes = 4096;  // a page answer stops short rather than grow past this
+  static constexpr uint8_t kBlobSlots = 4;                     // blob slots 0..3
+  static constexpr uint32_t kMaxBlobBytes = 64 * 1024 * 1024;  // per blob
+  static constexpr uint16_t kBlobChunkBytes = 1024;            // largest CHUNK, announced when a blob opens
+  static constexpr uint8_t kBlobWindowChunks = 16;             // CHUNKs the host may have in flight
+
+  explicit SimulatedDevice(std::string name = "device") : name(std::move(name)) {}
+
+  // Built-in schemas for the ttyMock1..3 ports; empty for unknown names
+  static std::vector<SimulatedParam> preset(const std::string& presetName);
+  // A synthetic schema cycling through every parameter type
+  static std::vector<SimulatedParam> generate(std::size_t count);
+
+  void setParams(std::vector<SimulatedParam> newParams);
+  // Integrity modes offered during PING negotiation; 0 behaves like a legacy device
+  void setCapabilities(uint16_t caps) { capabilities = caps; }
+  // Whether a negotiating PING answer carries the schema hash (on by default)
+  void setReportSchemaHash(bool enabled) { reportSchemaHash = enabled; }
+  const std::vector<SimulatedParam>& getParams() const { return params; }
+  const std::string& getName() const { return name; }
+
+  // Handles one request; every response (including unsolicited logs) goes through `respond`
+  void handleCommand(Protocol::Command cmd, std::span<const uint8_t> payload, const Responder& respond);
+  // Takes the samples subscriptions have due by `now` and sends TELEMETRY batches
+  // once they are full or old enough; call it at least every nextDeadline()
+  void poll(Clock::time_point now, const Responder& respond);
+  // When poll() next has work to do; Clock::time_point::max() without subscriptions
+  Clock::time_point nextDeadline() const;
+  // Drops every subscription and unsent sample, e.g. when the host goes away.
+  // A PING does the same: a host that (re)negotiates starts without subscriptions.
+  void cancelSubscriptions();
+
+  // Called right after a negotiation answer was handed to `respond`; the
+  // transport must frame everything after it with the new configuration
+  std::function<void(const Protocol::LinkConfig&)> onLinkConfig;
+  // Called with every blob that BLOB_COMMIT found complete and intact
+  std::function<void(uint8_t slot, std::span<const uint8_t> blob)> onBlob;
+
+ private:
+  // Logs entry `format` of kLogFormats with `args` laid out as `Fields`: as a
+  // LOG_TOKEN if the host negotiated kCapLogTokens, as CMD_LOG text otherwise.
+  // Nothing is sent below the host's minimum level.
+  template <typename... Fields>
+  void sendLog(const Responder& respond, uint8_t level, uint8_t format, const typename Fields::Type&... args);
+  void emitLog(const Responder& respond, uint8_t level, uint8_t format);
+  // The GET_SCHEMA payload
+  void appendSchema(std::vector<uint8_t>& out) const;
+  // One READ_ALL / READ_CHANGES entry
+  void appendValue(const SimulatedParam& p);
+  // The answer to GET_SCHEMA_PAGE or READ_VALUE_PAGE
+  void appendPage(Protocol::Command cmd, std::span<const uint8_t> request);
+  // WRITE_VALUE(_WIDE) once the id is read; `value` is laid out by the parameter's type
+  void writeValue(uint16_t id, std::span<const uint8_t> value, const Responder& respond);
+  // Applies a CMD_WRITE_ALL batch if every entry is valid; fills `response` with the ack
+  void writeAll(std::span<const uint8_t> payload, const Responder& respond);
+  void subscribe(std::span<const uint8_t> payload);
+  void unsubscribe(std::span<const uint8_t> payload);
+  void flushTelemetry(const Responder& respond);
+  // BLOB_OPEN, CHUNK and BLOB_COMMIT; each fills `response`
+  void openBlob(std::span<const uint8_t> payload);
+  void receiveChunk(std::span<const uint8_t> payload);
+  void commitBlob();
+
+  struct Subscription {
+    std::size_t index;  // into params
+    uint32_t periodUs;
+    Clock::time_point next;
+  };
+
+  std::string name;
+  std::vector<SimulatedParam> params;
+  uint16_t capabilities = Protocol::kAllCapabilities;
+  bool reportSchemaHash = true;
+  uint64_t schemaHash = 0;  // Protocol::HashSchema of the current params
+  uint32_t changeVersion = 0;  // bumped by every value change
+  std::vector<uint8_t> response;  // reused between requests
+  bool logTokens = false;                    // the host negotiated kCapLogTokens
+  uint8_t minLogLevel = Protocol::kLogInfo;  // set by SET_LOG_LEVEL; a PING resets it
+  std::vector<uint8_t> logArgs;              // arguments of the log being sent
+  std::vector<uint8_t> logPacket;            // LOG_TOKEN or CMD_LOG payload
+  struct StagedWrite {
+    std::size_t index;  // into params
+    float value;
+    std::string_view text;  // into the request payload
+  };
+
+  std::vector<StagedWrite> staged;  // a WRITE_ALL batch being checked
+  std::vector<Subscription> subscriptions;
+  std::vector<uint8_t> telemetry;  // batch being filled: [time u32][count]{id, value f32}
+  Clock::time_point batchStart;    // time of its first sample
+  Clock::time_point epoch = Clock::now();  // telemetry timestamps count from here
+
+  // The blob being received. It outlives the host's connection, so a host that
+  // opens the same blob again resumes where the last one stopped.
+  struct Blob {
+    bool open = false;
+    bool committed = false;  // a repeated BLOB_COMMIT gets the same answer
+    uint8_t slot = 0;
+    uint32_t size = 0;
+    uint32_t crc = 0;       // announced in BLOB_OPEN
+    uint32_t crcSoFar = 0;  // of `data`
+    std::vector<uint8_t> data;  // received in order
+  };
+  Blob blob;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "ICommunication.hpp"
+#include "IoLoop.hpp"
+
+// Stream socket transport for serial servers and simulators. The port string
+// selects the endpoint: "unix:/run/dev0.sock" or "tcp:<host>:<port>" (IPv6
+// hosts in brackets). TCP connections disable Nagle. The baud rate is ignored.
+class SocketPort : public ICommunication {
+ public:
+  static constexpr const char* kUnixPrefix = "unix:";
+  static constexpr const char* kTcpPrefix = "tcp:";
+  static constexpr int kConnectTimeoutMs = 2000;
+
+  static bool isSocketUri(const std::string& port);
+
+  // Same threading model as LinuxSerialPort: serviced by `sharedLoop` if given
+  explicit SocketPort(IoLoop* sharedLoop = nullptr);
+  ~SocketPort() override;
+
+  bool open(const std::string& port, int baudRate) override;
+  void close() override;
+  bool isOpen() const override;
+  std::size_t read(std::span<uint8_t> buffer) override;
+  std::size_t write(std::span<const uint8_t> data) override;
+  std::size_t writev(std::span<const std::span<const uint8_t>> chunks) override;
+  std::vector<std::string> listPorts() override { return {}; }
+
+ private:
+  static int connectUnix(const std::string& path);
+  static int connectTcp(const std::string& hostPort);
+  static bool waitConnected(int fd);
+
+  int fd = -1;
+  IoLoop* sharedLoop;
+  std::unique_ptr<IoLoop> ownLoop;
+  IoLoop* ioLoop = nullptr;
+  IoChannel channel;
+};
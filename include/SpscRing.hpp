@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// Lock-free single-producer/single-consumer byte ring.
+// One thread may push()/commit(), another may pop()/consume(). Indices run freely
+// and are masked on access, so Capacity must be a power of two.
+template <std::size_t Capacity>
+class SpscRing {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+ public:
+  // Producer side
+  std::size_t push(const uint8_t* data, std::size_t size) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    std::size_t n = std::min(size, Capacity - (h - tail.load(std::memory_order_acquire)));
+    std::size_t first = std::min(n, Capacity - (h & kMask));
+    std::memcpy(&buffer[h & kMask], data, first);
+    std::memcpy(&buffer[0], data + first, n - first);
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+
+  // Largest contiguous free region; fill it and then commit() the bytes written.
+  std::span<uint8_t> writeSegment() {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    std::size_t free = Capacity - (h - tail.load(std::memory_order_acquire));
+    return {&buffer[h & kMask], std::min(free, Capacity - (h & kMask))};
+  }
+  void commit(std::size_t n) { head.store(head.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+  // Consumer side
+  std::size_t pop(uint8_t* out, std::size_t size) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    std::size_t n = std::min(size, head.load(std::memory_order_acquire) - t);
+    std::size_t first = std::min(n, Capacity - (t & kMask));
+    std::memcpy(out, &buffer[t & kMask], first);
+    std::memcpy(out + first, &buffer[0], n - first);
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  // Largest contiguous readable region; consume() the bytes actually used.
+  std::span<const uint8_t> readSegment() const {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    std::size_t used = head.load(std::memory_order_acquire) - t;
+    return {&buffer[t & kMask], std::min(used, Capacity - (t & kMask))};
+  }
+  void consume(std::size_t n) { tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+  // Either side
+  std::size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() == Capacity; }
+  static constexpr std::size_t capacity() { return Capacity; }
+
+  // Only safe while neither side is active.
+  void clear() {
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr std::size_t kMask = Capacity - 1;
+
+  alignas(64) std::atomic<std::size_t> head{0};
+  alignas(64) std::atomic<std::size_t> tail{0};
+  alignas(64) std::array<uint8_t, Capacity> buffer{};
+};
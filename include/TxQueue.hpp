@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "Cobs.hpp"
+#include "ICommunication.hpp"
+#include "Protocol.hpp"
+
+// Coalesces outgoing packets so a burst costs one write per flush instead of one
+// per packet. Packets are serialized in place into a buffer allocated once at
+// construction; flush() is called once per tick or when the threshold is hit.
+// In COBS framing a packet is built a few bytes further along and encoded in
+// place when it is committed, so no second buffer is involved.
+class TxQueue {
+ public:
+  struct Stats {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t flushes = 0;
+    uint32_t lastFlushPackets = 0;
+    uint32_t lastFlushBytes = 0;
+  };
+
+  static constexpr std::size_t kCapacity = 8 * 1024;
+  static constexpr std::size_t kDefaultFlushThreshold = 4 * 1024;
+  // Worst-case framing bytes per packet (largest header + largest trailer)
+  static constexpr std::size_t kOverhead = Protocol::kMaxHeaderSize + Protocol::kMaxTrailerSize;
+  // Buffer space a packet with `length` payload bytes may take in the current framing
+  std::size_t frameBound(std::size_t length) const;
+
+  explicit TxQueue(ICommunication* comm, std::size_t flushThreshold = kDefaultFlushThreshold);
+
+  // Reserves a packet with `length` payload bytes and returns the payload region
+  // to fill in; commitPacket() then seals it. If no room can be made the packet is
+  // dropped and isPacketOpen() is false. Payloads near kCapacity go through enqueue().
+  // `sequence` is only sent on sequenced links, `address` on addressed ones.
+  std::span<uint8_t> beginPacket(Protocol::Command cmd, std::size_t length, uint8_t sequence = 0,
+                                 uint8_t address = 0);
+  void commitPacket();
+
+  // Copies a ready-made payload; oversized payloads bypass the buffer.
+  void enqueue(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence = 0, uint8_t address = 0);
+
+  void flush();
+
+  // Applies to packets begun after the call; queued packets keep their framing
+  void setLinkConfig(const Protocol::LinkConfig& config) { link = config; }
+
+  bool isPacketOpen() const { return packetOpen; }
+  bool empty() const { return used == 0; }
+  std::size_t pendingBytes() const { return used; }
+  // Whether a packet with `length` payload bytes can be begun without a flush
+  bool fits(std::size_t length) const { return used + frameBound(length) <= kCapacity; }
+  const Stats& stats() const { return counters; }
+
+ private:
+  // Header for the current link at `out`; returns its size
+  std::size_t writeHeader(uint8_t* out, Protocol::Command cmd, std::size_t length, uint8_t sequence,
+                          uint8_t address) const;
+
+  ICommunication* comm;
+  Protocol::LinkConfig link;
+  std::size_t threshold;
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> scratch;  // COBS frames too large for `buffer`; sized on first use
+  std::size_t used = 0;
+  std::size_t packetStart = 0;  // raw header; the COBS frame starts at `used`
+  std::size_t packetLength = 0;
+  bool packetOpen = false;
+  uint32_t queuedPackets = 0;
+  Stats counters;
+};
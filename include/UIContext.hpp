@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "DeviceParameter.hpp"
 #include "raylib.h"
@@ -26,7 +29,17 @@ struct ConnectionSettings {
 
   char portList[2048] = {0};
   std::vector<std::string> portPaths;
-  const char* baudRates = "9600;19200;38400;57600;115200";
+  // Dropdown labels, one per entry of kBaudRateValues
+  static constexpr const char* kBaudRates =
+      "9600;19200;38400;57600;115200;230400;460800;921600;1000000;2000000;3000000";
+  static constexpr int kBaudRateValues[] = {9600,   19200,  38400,   57600,   115200, 230400,
+                                            460800, 921600, 1000000, 2000000, 3000000};
+  static constexpr int kBaudRateCount = static_cast<int>(std::size(kBaudRateValues));
+  static_assert(std::ranges::count(std::string_view(kBaudRates), ';') + 1 == kBaudRateCount,
+                "kBaudRates needs one label per kBaudRateValues entry");
+  bool lowLatency = false;
+
+  int selectedBaudRate() const { return kBaudRateValues[baudRateIndex]; }
 
   bool isDropdownOpen() const { return portDropdownEdit || baudDropdownEdit; }
 };
@@ -51,6 +64,7 @@ struct VisualSettings {
 
 struct DeviceState {
   std::vector<DeviceParameter> config;
+  uint32_t valuesVersion = 0;  // device change counter the config values reflect (delta reads)
   std::vector<DeviceLog> deviceLogs;
   std::string connectedDeviceName = "";
   Vector2 configScroll = {0, 0};
@@ -60,12 +74,12 @@ struct DeviceState {
 struct AppUIContext {
   ConnectionSettings connection;
   VisualSettings visual;
-  DeviceState device;
+
+  // Session shown in the configuration panel (CommunicationManager session id)
+  int activeSession = -1;
 
   // Internal Timers/Flags
-  double stateTransitionTime = 0.0;
   double welcomeTimer = 0.0;
-  bool pendingSchemaResponse = false;
 
   bool anyDropdownOpen() const { return connection.isDropdownOpen() || visual.isDropdownOpen(); }
 };
@@ -9,8 +9,10 @@ namespace UIManager {
 
 void ApplyTheme(int index);
 void ApplyFont(Font font, int fontSize);
-void UpdateStateLogic(AppUIContext& ctx, AppSM& sm);
+void UpdateStateLogic(AppUIContext& ctx, AppSM& sm, CommunicationManager::Manager& comms);
 void HandleInput(AppUIContext& ctx);
+// Rebuilds the port dropdown, keeping the selected port when it is still present
+void UpdatePortList(AppUIContext& ctx, const std::vector<std::string>& ports);
 
 // Main entry point for drawing the entire UI
 void Draw(AppUIContext& ctx, AppSM& sm, CommunicationManager::Manager& comms);
@@ -0,0 +1,77 @@
+#include "BlobTransfer.hpp"
+#include <algorithm>
+#include "Crc.hpp"
+
+void BlobTransfer::start(uint8_t blobSlot, std::span<const uint8_t> blob) {
+  state = State::kOpening;
+  data = blob;
+  slot = blobSlot;
+  crc = Crc::Crc32c(blob);
+  counters = {};
+  counters.total = static_cast<uint32_t>(blob.size());
+}
+
+void BlobTransfer::opened(uint32_t resumeAt, uint16_t deviceChunk, uint8_t deviceWindow, Clock::time_point now) {
+  state = State::kStreaming;
+  chunkBytes = std::clamp<uint16_t>(deviceChunk, 1, kMaxChunkBytes);
+  windowBytes = static_cast<uint32_t>(chunkBytes) * std::clamp<uint8_t>(deviceWindow, 1, kMaxWindowChunks);
+  counters.acked = counters.resumedAt = std::min(resumeAt, counters.total);
+  sentUpTo = counters.acked;
+  lastAck = now;
+  stalls = 0;
+  duplicates = 0;
+  rewoundAt = UINT32_MAX;
+}
+
+bool BlobTransfer::nextChunk(uint32_t& offset, std::span<const uint8_t>& bytes) const {
+  if (state != State::kStreaming || sentUpTo >= counters.total) return false;
+  uint32_t room = counters.acked + windowBytes - sentUpTo;
+  if (room == 0) return false;
+  // Whole chunks only, unless the blob ends first: a short one would waste a header
+  uint32_t size = std::min<uint32_t>(chunkBytes, counters.total - sentUpTo);
+  if (size > room) return false;
+  offset = sentUpTo;
+  bytes = data.subspan(sentUpTo, size);
+  return true;
+}
+
+void BlobTransfer::sent(std::size_t bytes, Clock::time_point now) {
+  if (sentUpTo == counters.acked) lastAck = now;  // the stall clock starts with the first chunk in flight
+  sentUpTo += static_cast<uint32_t>(bytes);
+  counters.chunks++;
+  counters.bytesSent += bytes;
+}
+
+bool BlobTransfer::acknowledged(uint32_t received, Clock::time_point now) {
+  if (state != State::kStreaming) return false;
+  received = std::min(received, counters.total);
+  lastAck = now;  // even a repeat shows the device is still working through the chunks in flight
+  if (received <= counters.acked) {
+    // The device dropped a chunk that did not continue its data: everything after it is lost too
+    if (received == counters.acked && sentUpTo > counters.acked && ++duplicates >= kDuplicateAcks &&
+        rewoundAt != counters.acked) {
+      rewind(now);
+    }
+    return false;
+  }
+  counters.acked = received;
+  sentUpTo = std::max(sentUpTo, received);
+  stalls = 0;
+  duplicates = 0;
+  return true;
+}
+
+BlobTransfer::Stall BlobTransfer::checkStall(Clock::time_point now, uint32_t rtoMs) {
+  if (!inFlight() || now - lastAck < std::chrono::milliseconds(kStallTimeoutMs + rtoMs)) return Stall::kNone;
+  if (++stalls > kMaxStalls) return Stall::kGaveUp;
+  rewind(now);
+  return Stall::kRewound;
+}
+
+void BlobTransfer::rewind(Clock::time_point now) {
+  sentUpTo = counters.acked;
+  rewoundAt = counters.acked;
+  duplicates = 0;
+  lastAck = now;
+  counters.rewinds++;
+}
@@ -0,0 +1,43 @@
+#include "CapturePort.hpp"
+#include "Log.hpp"
+
+CapturePort::CapturePort(std::unique_ptr<ICommunication> inner) : inner(std::move(inner)) {}
+
+CapturePort::~CapturePort() { stopRecording(); }
+
+void CapturePort::close() {
+  stopRecording();
+  inner->close();
+}
+
+std::size_t CapturePort::read(std::span<uint8_t> buffer) {
+  std::size_t n = inner->read(buffer);
+  if (!writer.isOpen()) return n;
+  if (n > 0) {
+    writer.append(LinkTrace::Direction::kRx, buffer.first(n));
+  } else {
+    writer.poll();  // the handler reads every update, so this is the idle link's flush tick
+  }
+  return n;
+}
+
+std::size_t CapturePort::write(std::span<const uint8_t> data) {
+  std::size_t n = inner->write(data);
+  if (n > 0 && writer.isOpen()) writer.append(LinkTrace::Direction::kTx, data.first(n));
+  return n;
+}
+
+std::size_t CapturePort::writev(std::span<const std::span<const uint8_t>> chunks) {
+  std::size_t n = inner->writev(chunks);
+  // Transports accept a gathered write whole or not at all (see IoChannel::writev)
+  if (n > 0 && writer.isOpen()) writer.append(LinkTrace::Direction::kTx, chunks);
+  return n;
+}
+
+bool CapturePort::startRecording(const std::string& path) {
+  if (!writer.open(path)) return false;
+  Log::Trace::Info() << "Recording to " << path;
+  return true;
+}
+
+void CapturePort::stopRecording() { writer.close(); }
@@ -0,0 +1,70 @@
+#include "Cobs.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Cobs {
+
+namespace {
+
+constexpr std::size_t kMaxBlock = 254;  // data bytes behind a 0xFF code
+
+}  // namespace
+
+void Encoder::put(std::span<const uint8_t> data) {
+  const uint8_t* in = data.data();
+  std::size_t left = data.size();
+  while (left > 0) {
+    std::size_t room = kMaxBlock - static_cast<std::size_t>(cursor - code - 1);
+    std::size_t chunk = std::min(left, room);
+    const void* zero = std::memchr(in, 0, chunk);
+    std::size_t run = zero ? static_cast<std::size_t>(static_cast<const uint8_t*>(zero) - in) : chunk;
+
+    // memmove: in place, the output trails the input but may overlap it
+    std::memmove(cursor, in, run);
+    cursor += run;
+    in += run;
+    left -= run;
+
+    // A zero ends the block (and is implied by its code); a full block ends without one
+    bool full = static_cast<std::size_t>(cursor - code - 1) == kMaxBlock;
+    if (zero || full) {
+      if (zero) {
+        in++;
+        left--;
+      }
+      *code = static_cast<uint8_t>(cursor - code);
+      code = cursor++;
+    }
+  }
+}
+
+std::size_t Encoder::finish() {
+  *code = static_cast<uint8_t>(cursor - code);
+  *cursor++ = kDelimiter;
+  std::size_t size = static_cast<std::size_t>(cursor - start);
+  code = start;
+  cursor = start + 1;
+  return size;
+}
+
+bool Decode(std::span<const uint8_t> frame, uint8_t* out, std::size_t& decodedSize) {
+  const uint8_t* in = frame.data();
+  const uint8_t* end = in + frame.size();
+  uint8_t* dst = out;
+  while (in < end) {
+    uint8_t code = *in++;
+    if (code == kDelimiter) return false;
+    std::size_t run = code - 1u;
+    if (run > static_cast<std::size_t>(end - in)) return false;
+    if (std::memchr(in, 0, run)) return false;
+    std::memmove(dst, in, run);
+    dst += run;
+    in += run;
+    // Every block but a full one stands for a trailing zero, except at the very end
+    if (code != 0xFF && in < end) *dst++ = 0;
+  }
+  decodedSize = static_cast<std::size_t>(dst - out);
+  return true;
+}
+
+}  // namespace Cobs
@@ -1,110 +1,637 @@
 #include "CommunicationManager.hpp"
+#include <algorithm>
 #include <chrono>
+#include <ctime>
+#include <filesystem>
 #include <thread>
+#include <utility>
 #include "LinuxSerialPort.hpp"
 #include "Log.hpp"
 #include "MockSerialPort.hpp"
+#include "ReplayPort.hpp"
+#include "SocketPort.hpp"
 
 namespace CommunicationManager {
 
-Manager::Manager(AppUIContext& ctx, AppSM& sm) : ctx(ctx), sm(sm) {
-  realSerial = std::make_unique<LinuxSerialPort>();
-  mockSerial = std::make_unique<MockSerialPort>();
+namespace {
+
+// Reloads every value the session has rows for: READ_ALL, or on a paged link one
+// READ_VALUE_PAGE per run of loaded rows
+void requestValues(Session& session) {
+  if (!session.paged) {
+    session.protocol->requestAllValues();
+    return;
+  }
+  const auto& config = session.device.config;
+  for (std::size_t i = 0; i < config.size();) {
+    if (!config[i].loaded) {
+      i++;
+      continue;
+    }
+    std::size_t end = i;
+    while (end < config.size() && config[end].loaded && end - i < Manager::kValuePageRows) end++;
+    session.protocol->requestValuePage(static_cast<uint16_t>(i), static_cast<uint8_t>(end - i));
+    i = end;
+  }
+}
+
+// Protocol handlers for one session, bound at compile time by ProtocolHandler::update().
+// Payloads are decoded in place; a READ_ALL refresh only writes values into the config.
+struct SessionEvents {
+  Session& session;
+  const SchemaCache& schemaCache;
+  std::vector<uint16_t> settledBatch{};  // ids of the WRITE_ALL whose ack is being dispatched
+  std::size_t pageFirst = 0;             // rows [pageFirst, pageEnd) asked for by the page being dispatched
+  std::size_t pageEnd = 0;
+
+  const Protocol::ValueTypes& valueTypes() const { return session.valueTypes; }
+
+  void onSchema(Protocol::SchemaView schema) {
+    loadSchema(schema);
+    // Remember it under the hash the device reported, if it matches what was sent
+    uint64_t hash = session.protocol->getLinkConfig().schemaHash;
+    if (hash == 0) return;
+    if (Protocol::HashSchema(schema.bytes()) != hash) {
+      Log::App::Warning() << session.port << " sent a schema that does not match its hash; not caching it";
+      return;
+    }
+    schemaCache.store(hash, schema.bytes());
+  }
+
+  // Builds the parameter list and starts the value sync
+  void loadSchema(Protocol::SchemaView schema) {
+    auto& config = session.device.config;
+    config.clear();
+    config.reserve(schema.declaredCount());
+    session.valueTypes.fill(Protocol::ParamType::kNumeric);
+    for (const auto& entry : schema) {
+      session.valueTypes[entry.id] = entry.type;
+      DeviceParameter& p = config.emplace_back();
+      p.id = entry.id;
+      p.type = entry.type;
+      p.name = entry.name;
+      p.min = entry.min;
+      p.max = entry.max;
+      p.value = p.min;  // Default
+      p.lastSentValue = p.value;
+      p.lastSentString = p.stringValue;
+    }
+    session.device.valuesVersion = 0;
+    session.protocol->refreshValues(0);
+    session.stateTransitionTime = GetTime();
+    session.pendingSchemaResponse = true;  // UIManager::UpdateStateLogic notifies the SM
+  }
+
+  void onValues(Protocol::ValueListView values) { applyValues(values, 0); }
+
+  // Rows of a paged schema: the first page sizes the config, with placeholders for
+  // rows not seen yet, and the session counts as connected from then on
+  void onSchemaPage(uint16_t total, uint16_t first, Protocol::SchemaPageView page) {
+    if (!session.paged) return;
+    auto& config = session.device.config;
+    if (config.empty()) {
+      DeviceParameter placeholder{};
+      placeholder.loaded = false;
+      config.assign(total, placeholder);
+      session.stateTransitionTime = GetTime();
+      session.pendingSchemaResponse = true;  // UIManager::UpdateStateLogic notifies the SM
+    }
+    std::size_t row = first;
+    for (const auto& entry : page) {
+      if (row >= config.size()) break;
+      session.valueTypes[entry.id] = entry.type;
+      DeviceParameter& p = config[row++];
+      p.id = entry.id;
+      p.type = entry.type;
+      p.name = entry.name;
+      p.min = entry.min;
+      p.max = entry.max;
+      p.value = p.min;
+      p.lastSentValue = p.value;
+      p.lastSentString = p.stringValue;
+      p.loaded = true;
+      p.loading = false;
+    }
+    if (row > first) session.protocol->requestValuePage(first, static_cast<uint8_t>(row - first));
+    continuePage(row, &ProtocolHandler::requestSchemaPage);
+  }
+
+  void onValuePage(uint16_t first, Protocol::ValuePageView page) {
+    std::size_t row = applyValues(page, first);
+    continuePage(row, &ProtocolHandler::requestValuePage);
+  }
+
+  // A device may cut a page short to bound its answer; the rest is asked for at once
+  void continuePage(std::size_t answeredEnd, void (ProtocolHandler::*request)(uint16_t, uint8_t)) {
+    std::size_t end = std::min(std::exchange(pageEnd, 0), session.device.config.size());
+    if (answeredEnd <= pageFirst || answeredEnd >= end) return;  // complete, or no progress to build on
+    (session.protocol.get()->*request)(static_cast<uint16_t>(answeredEnd), static_cast<uint8_t>(end - answeredEnd));
+  }
+
+  // Writes a value list into the config from `slot` on; returns the slot after the last entry
+  template <typename View>
+  std::size_t applyValues(View values, std::size_t slot) {
+    auto& config = session.device.config;
+    // Devices answer in schema order, so the expected slot is checked first
+    for (const auto& value : values) {
+      if (slot >= config.size() || config[slot].id != value.id) {
+        auto it = std::find_if(config.begin(), config.end(), [&](const auto& p) { return p.id == value.id; });
+        if (it == config.end()) continue;
+        slot = static_cast<std::size_t>(it - config.begin());
+      }
+      DeviceParameter& p = config[slot++];
+      if (p.staged) continue;  // keep the user's edit until it is applied
+      if (p.type == Protocol::ParamType::kString) {
+        if (p.editMode) continue;  // the user is typing into it
+        p.stringValue = value.text;
+        p.lastSentString = p.stringValue;
+      } else {
+        p.value = value.value;
+        p.lastSentValue = value.value;
+      }
+    }
+    return slot;
+  }
+
+  // Only values changed since `valuesVersion` arrive; everything else is already current
+  void onChanges(uint32_t version, Protocol::ValueListView values) {
+    onValues(values);
+    session.device.valuesVersion = std::max(session.device.valuesVersion, version);
+  }
+
+  // Pushed samples, oldest first; a widget with an unacknowledged write keeps the user's value
+  void onTelemetry(uint32_t, Protocol::ValueListView samples) {
+    auto& config = session.device.config;
+    for (const auto& sample : samples) {
+      auto it = std::find_if(config.begin(), config.end(), [&](const auto& p) { return p.id == sample.id; });
+      if (it == config.end() || it->pending || it->staged) continue;
+      it->value = sample.value;
+      it->lastSentValue = sample.value;
+    }
+  }
+
+  void onWriteAck(uint16_t id) {
+    for (auto& p : session.device.config) {
+      if (p.id == id) p.pending = false;
+    }
+  }
+
+  // WRITE_ALL answers carry no ids; the request they settle does (see onRequestComplete)
+  void onWriteAllAck(const Protocol::WriteAllResult& result) {
+    unlockBatch();
+    if (!result.committed()) {
+      onLog(2, "Device rejected the batch at entry " + std::to_string(result.rejectedEntry) + "; nothing was applied");
+      requestValues(session);  // the device still has the old values; show them
+    }
+  }
+
+  void onRequestComplete(const RequestTracker::Result& result) {
+    if (result.command == Protocol::Command::kWriteAll) collectBatch(result.request);
+    if (result.command == Protocol::Command::kGetSchemaPage || result.command == Protocol::Command::kReadValuePage) {
+      std::size_t offset = 0;
+      uint16_t first;
+      uint8_t count;
+      if (Protocol::Wire::PageRequest::decode(result.request, offset, first, count)) {
+        pageFirst = first;
+        pageEnd = pageFirst + count;
+      }
+    }
+  }
+
+  void collectBatch(std::span<const uint8_t> request) {
+    settledBatch.clear();
+    for (const auto& entry : Protocol::ValueListView(request, {&session.valueTypes})) settledBatch.push_back(entry.id);
+  }
+
+  void unlockBatch() {
+    for (auto& p : session.device.config) {
+      if (std::find(settledBatch.begin(), settledBatch.end(), p.id) != settledBatch.end()) p.pending = false;
+    }
+    settledBatch.clear();
+  }
+
+  void onLog(uint8_t level, std::string_view message) {
+    DeviceState& device = session.device;
+    device.deviceLogs.push_back({level, std::string(message), (double)GetTime()});
+    if (device.deviceLogs.size() > 100) device.deviceLogs.erase(device.deviceLogs.begin());
+    device.logScroll.y = -1000000;  // Auto-scroll
+  }
+
+  void onLogFormats(Protocol::LogFormatsView formats) { session.logFormats.load(formats); }
+  void onLogToken(uint8_t level, uint8_t format, std::span<const uint8_t> args) {
+    onLog(level, session.logFormats.render(format, args));
+  }
+
+  // A (re)negotiated device starts without subscriptions and sends logs of every
+  // level; one with log tokens is asked for its format table and told the session's
+  // level. A paged device sends its schema a page at a time, as rows are shown;
+  // otherwise a schema cached under the hash it reported is used as is, and
+  // anything else is fetched.
+  void onLinkReady(const Protocol::LinkConfig& config) {
+    session.telemetryOn = false;
+    session.blobFile.close();  // renegotiating ended any upload
+    session.logFormats.clear();
+    if (config.supports(Protocol::kCapLogTokens)) {
+      session.protocol->requestLogFormats();
+      session.protocol->setLogLevel(session.logLevel);
+    }
+    session.paged = config.supports(Protocol::kCapPaged);
+    if (session.paged) {
+      session.device.config.clear();
+      session.valueTypes.fill(Protocol::ParamType::kNumeric);
+      session.protocol->requestSchemaPage(0, Manager::kSchemaPageRows);
+      return;
+    }
+    if (auto cached = schemaCache.find(config.schemaHash)) {
+      Log::App::Info() << session.port << ": schema " << std::hex << config.schemaHash << " loaded from cache";
+      loadSchema(Protocol::SchemaView(cached.payload()));
+      return;
+    }
+    session.protocol->requestSchema();
+  }
+
+  void onBlobDone(Protocol::Wire::BlobStatus status) {
+    std::string name = std::filesystem::path(session.blobFile.path()).filename().string();
+    if (status == Protocol::Wire::BlobStatus::kOk) {
+      onLog(0, "Uploaded " + name);
+    } else {
+      onLog(2, "Upload of " + name + " failed: " + Protocol::Wire::BlobStatusName(status));
+    }
+    session.blobFile.close();
+  }
+
+  // An unacknowledged write unlocks its widget and reloads the device's values;
+  // an unanswered schema request ends the session (see Manager::update), unless
+  // it was for a later page: those rows are asked for again when next shown
+  void onRequestFailed(const RequestTracker::Result& result) {
+    if (result.command == Protocol::Command::kGetSchema) {
+      session.schemaFailed = true;
+      return;
+    }
+    if (result.command == Protocol::Command::kGetSchemaPage) {
+      auto& config = session.device.config;
+      std::size_t offset = 0;
+      uint16_t first;
+      uint8_t count;
+      if (config.empty()) session.schemaFailed = true;
+      if (!Protocol::Wire::PageRequest::decode(result.request, offset, first, count)) return;
+      for (std::size_t i = first; i < config.size() && i < first + count; i++) config[i].loading = false;
+      return;
+    }
+    if (result.command == Protocol::Command::kSetLogLevel) {
+      onLog(2, "Device did not confirm the log level");
+      return;
+    }
+    if (result.command == Protocol::Command::kSubscribe) {
+      session.telemetryOn = false;
+      onLog(2, "Device did not confirm the telemetry subscription");
+      return;
+    }
+    if (result.command == Protocol::Command::kWriteAll) {
+      collectBatch(result.request);
+      onLog(2, "No acknowledgement for a batch of " + std::to_string(settledBatch.size()) + " values after " +
+                   std::to_string(result.attempts) + " attempts");
+      unlockBatch();
+      requestValues(session);
+      return;
+    }
+    // Both write commands start with the id, 8 or 16 bits wide
+    uint16_t id = 0;
+    std::size_t offset = 0;
+    if (result.command == Protocol::Command::kWriteValue) {
+      uint8_t narrow;
+      if (!Protocol::Wire::ParamId::decode(result.request, offset, narrow)) return;
+      id = narrow;
+    } else if (result.command != Protocol::Command::kWriteValueWide ||
+               !Protocol::Wire::WideParamId::decode(result.request, offset, id)) {
+      return;
+    }
+    for (auto& p : session.device.config) {
+      if (p.id != id || !p.pending) continue;
+      p.pending = false;
+      onLog(2, "No acknowledgement for " + p.name + " after " + std::to_string(result.attempts) + " attempts");
+    }
+    requestValues(session);
+  }
+};
+
+// Splits "<port>@<address>" (address 1-255); false for a plain port
+bool parseBusPort(const std::string& port, std::string& line, uint8_t& address) {
+  std::size_t at = port.rfind('@');
+  if (at == std::string::npos || at + 1 == port.size() || port.size() - at > 4) return false;
+  if (!std::all_of(port.begin() + at + 1, port.end(), [](char c) { return c >= '0' && c <= '9'; })) return false;
+  int value = std::stoi(port.substr(at + 1));
+  if (value == 0 || value > 255) return false;
+  line = port.substr(0, at);
+  address = static_cast<uint8_t>(value);
+  return true;
 }
 
-Manager::~Manager() { disconnect(); }
+// One WRITE_VALUE carrying the parameter's current value
+void writeParam(ProtocolHandler& protocol, const DeviceParameter& param) {
+  if (param.type == Protocol::ParamType::kString) {
+    protocol.writeString(param.id, param.stringValue);
+  } else {
+    protocol.writeValue(param.id, param.value);
+  }
+}
+
+}  // namespace
+
+Session::Session(int id, const std::string& port, std::shared_ptr<ICommunication> comm)
+    : id(id), port(port), comm(std::move(comm)) {}
+
+Manager::Manager(AppUIContext& ctx) : ctx(ctx) {}
+
+Manager::~Manager() { disconnectAll(); }
 
 std::vector<std::string> Manager::listPorts() {
-  auto ports = realSerial->listPorts();
+  std::vector<std::string> ports;
+  for (const auto& info : portRegistry.ports()) ports.push_back(info.path);
+  ports.insert(ports.end(), extraPorts.begin(), extraPorts.end());
   ports.push_back("ttyMock1");
   ports.push_back("ttyMock2");
   ports.push_back("ttyMock3");
+
+  std::error_code ec;
+  std::vector<std::string> traces;
+  for (const auto& entry : std::filesystem::directory_iterator(kCaptureDir, ec)) {
+    if (entry.path().extension() == ".trace") traces.push_back(ReplayPort::kPrefix + entry.path().string());
+  }
+  std::sort(traces.begin(), traces.end());
+  ports.insert(ports.end(), traces.begin(), traces.end());
   return ports;
 }
 
+void Manager::addPort(const std::string& port) {
+  if (std::find(extraPorts.begin(), extraPorts.end(), port) != extraPorts.end()) return;
+  extraPorts.push_back(port);
+  portsDirty = true;
+}
+
+bool Manager::pollPorts() {
+  bool changed = portRegistry.poll();
+  return std::exchange(portsDirty, false) || changed;
+}
+
 void Manager::update() {
-  if (protocol) {
-    protocol->update();
+  // Bytes were already drained by the I/O thread; this only parses what is queued
+  for (std::size_t i = 0; i < sessions.size();) {
+    Session& s = *sessions[i];
+    if (!s.comm->isOpen()) {
+      Log::App::Error() << "Lost connection to " << s.port;
+      s.sm.process_event(ConnectionFailedEvent{});
+      disconnect(s.id);
+      continue;
+    }
+    if (s.protocol) {
+      SessionEvents events{s, schemaCache};
+      s.protocol->update(events);
+    }
+    if (s.schemaFailed) {
+      Log::App::Error() << s.port << " does not answer schema requests";
+      s.sm.process_event(ConnectionFailedEvent{});
+      disconnect(s.id);
+      continue;
+    }
+    ++i;
   }
 }
 
-void Manager::connect(const std::string& port, int baud) {
-  using namespace boost::sml::literals;
+void Manager::flush() {
+  for (auto& s : sessions) {
+    if (s->protocol) s->protocol->flush();
+  }
+}
 
+Session* Manager::getSession(int sessionId) const {
+  auto it = std::find_if(sessions.begin(), sessions.end(), [&](const auto& s) { return s->id == sessionId; });
+  return it != sessions.end() ? it->get() : nullptr;
+}
+
+Session* Manager::findSession(const std::string& port) const {
+  auto it = std::find_if(sessions.begin(), sessions.end(), [&](const auto& s) { return s->port == port; });
+  return it != sessions.end() ? it->get() : nullptr;
+}
+
+std::unique_ptr<ICommunication> Manager::createTransport(const std::string& port, bool lowLatency) {
+  if (port.rfind(ReplayPort::kPrefix, 0) == 0) {
+    return std::make_unique<ReplayPort>();
+  }
+  if (SocketPort::isSocketUri(port)) {
+    return std::make_unique<SocketPort>(&ioLoop);
+  }
   if (port.find("ttyMock") != std::string::npos) {
-    activeComm = mockSerial.get();
-  } else {
-    activeComm = realSerial.get();
+    return std::make_unique<MockSerialPort>();
+  }
+  auto serial = std::make_unique<LinuxSerialPort>(&ioLoop);
+  serial->setLowLatency(lowLatency);
+  return serial;
+}
+
+Session* Manager::connect(const std::string& port, int baud, bool lowLatency) {
+  if (Session* existing = findSession(port)) {
+    ctx.activeSession = existing->id;
+    return existing;
   }
 
-  if (activeComm && activeComm->open(port, baud)) {
-    ctx.device.connectedDeviceName = port;
-    sm.process_event(ConnectEvent{port, baud});
+  std::string line = port;
+  uint8_t address = 0;
+  bool onBus = parseBusPort(port, line, address);
+  auto sibling = std::find_if(sessions.begin(), sessions.end(), [&](const auto& s) {
+    std::string siblingLine;
+    uint8_t siblingAddress;
+    return onBus && s->bus && parseBusPort(s->port, siblingLine, siblingAddress) && siblingLine == line;
+  });
+
+  std::shared_ptr<ICommunication> comm;
+  std::shared_ptr<ProtocolHandler::Bus> bus;
+  CapturePort* capture = nullptr;
+  if (sibling != sessions.end()) {
+    // Another device on a bus that is already open
+    comm = (*sibling)->comm;
+    bus = (*sibling)->bus;
+    capture = (*sibling)->capture;
+  } else {
+    auto transport = createTransport(line, lowLatency);
+    if (!transport || !transport->open(line, baud)) return nullptr;
 
-    // Handle optional delay
-    if (kTransitionDelayMs > 0) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(kTransitionDelayMs));
+    // Live links go through a capture decorator so they can be recorded at any time
+    if (line.rfind(ReplayPort::kPrefix, 0) != 0) {
+      auto wrapped = std::make_unique<CapturePort>(std::move(transport));
+      capture = wrapped.get();
+      transport = std::move(wrapped);
     }
+    comm = std::move(transport);
+    if (onBus) bus = std::make_shared<ProtocolHandler::Bus>(comm.get());
+  }
 
-    sm.process_event(ConnectionSuccessEvent{});
-    setupProtocol();
+  auto& session = *sessions.emplace_back(std::make_unique<Session>(nextSessionId++, port, std::move(comm)));
+  session.bus = std::move(bus);
+  session.busAddress = address;
+  session.capture = capture;
+  session.device.connectedDeviceName = port;
+  ctx.activeSession = session.id;
+  session.sm.process_event(ConnectEvent{port, baud});
+
+  // Handle optional delay
+  if (kTransitionDelayMs > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kTransitionDelayMs));
   }
+
+  session.sm.process_event(ConnectionSuccessEvent{});
+  setupProtocol(session);
+  return &session;
 }
 
-void Manager::disconnect() {
-  using namespace boost::sml::literals;
-  if (activeComm) {
-    activeComm->close();
+void Manager::disconnect(int sessionId) {
+  auto it = std::find_if(sessions.begin(), sessions.end(), [&](const auto& s) { return s->id == sessionId; });
+  if (it == sessions.end()) return;
+
+  Session& s = **it;
+  if (s.capture && s.capture->isRecording()) portsDirty = true;
+  if (s.comm.use_count() == 1) s.comm->close();  // the last device on its bus
+  s.protocol.reset();
+  s.sm.process_event(DisconnectEvent{});
+  it = sessions.erase(it);
+
+  if (ctx.activeSession == sessionId) {
+    // Fall back to a neighbouring session, if any
+    if (it != sessions.end()) {
+      ctx.activeSession = (*it)->id;
+    } else {
+      ctx.activeSession = sessions.empty() ? -1 : sessions.back()->id;
+    }
   }
-  activeComm = nullptr;
-  protocol.reset();
-  ctx.device.connectedDeviceName = "";
-  sm.process_event(DisconnectEvent{});
 }
 
-bool Manager::isConnected() const { return activeComm && activeComm->isOpen(); }
+void Manager::disconnectAll() {
+  while (!sessions.empty()) disconnect(sessions.front()->id);
+}
 
-void Manager::setupProtocol() {
-  if (!activeComm || !activeComm->isOpen()) return;
+bool Manager::setRecording(Session& session, bool enabled) {
+  if (!session.capture) return false;
+  if (!enabled) {
+    if (session.capture->isRecording()) portsDirty = true;
+    session.capture->stopRecording();
+    return true;
+  }
+  if (session.capture->isRecording()) return true;
 
-  protocol = std::make_unique<ProtocolHandler>(activeComm);
+  std::error_code ec;
+  std::filesystem::create_directories(kCaptureDir, ec);
 
-  // Wire up listeners from old UIManager logic
-  protocol->onSchemaReceived = [&](const std::vector<DeviceParameter>& s) {
-    ctx.device.config = s;
-    for (auto& p : ctx.device.config) {
-      p.lastSentValue = p.value;
-      p.lastSentString = p.stringValue;
+  char stamp[32];
+  std::time_t now = std::time(nullptr);
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+  std::string name = session.port.substr(session.port.find_last_of('/') + 1);
+  std::string path = std::string(kCaptureDir) + "/" + name + "-" + stamp + ".trace";
+  return session.capture->startRecording(path);
+}
+
+void Manager::submitEdit(Session& session, DeviceParameter& param) {
+  if (session.stageEdits) {
+    param.staged = true;
+    return;
+  }
+  param.pending = true;
+  if (session.protocol) writeParam(*session.protocol, param);
+}
+
+void Manager::loadRows(Session& session, std::size_t first, std::size_t last) {
+  if (!session.paged || !session.protocol) return;
+  auto& config = session.device.config;
+  last = std::min(last, config.size());
+  for (std::size_t i = first; i < last;) {
+    if (config[i].loaded || config[i].loading) {
+      i++;
+      continue;
     }
-    protocol->requestAllValues();
-    ctx.stateTransitionTime = GetTime();
-    ctx.pendingSchemaResponse = true;  // Still using ctx to notify SM in main for now
-  };
-
-  protocol->onValuesReceived = [&](const std::vector<std::pair<uint8_t, float>>& v) {
-    for (auto& val : v) {
-      for (auto& p : ctx.device.config) {
-        if (p.id == val.first) {
-          p.value = val.second;
-          p.lastSentValue = val.second;
-        }
-      }
+    std::size_t end = i;
+    while (end < last && !config[end].loaded && !config[end].loading && end - i < kSchemaPageRows) {
+      config[end++].loading = true;
     }
-  };
+    session.protocol->requestSchemaPage(static_cast<uint16_t>(i), static_cast<uint8_t>(end - i));
+    i = end;
+  }
+}
 
-  protocol->onWriteAck = [&](uint8_t id) {
-    for (auto& p : ctx.device.config) {
-      if (p.id == id) p.pending = false;
+void Manager::refreshValues(Session& session) {
+  if (!session.protocol) return;
+  if (session.paged) {
+    requestValues(session);
+  } else {
+    session.protocol->refreshValues(session.device.valuesVersion);
+  }
+}
+
+std::size_t Manager::applyStaged(Session& session) {
+  if (!session.protocol) return 0;
+  // WRITE_ALL entries carry 8-bit ids
+  bool batched = session.protocol->getLinkConfig().supports(Protocol::kCapWriteAll) &&
+                 std::none_of(session.device.config.begin(), session.device.config.end(),
+                              [](const auto& p) { return p.staged && p.id > 0xFF; });
+  Protocol::WriteBatch batch;
+  std::size_t sent = 0;
+  for (auto& p : session.device.config) {
+    if (!p.staged) continue;
+    if (batched) {
+      auto id = static_cast<uint8_t>(p.id);
+      bool added = p.type == Protocol::ParamType::kString ? batch.add(id, p.stringValue) : batch.add(id, p.value);
+      if (!added) break;  // full; the rest stays staged for the next apply
     }
-  };
+    p.staged = false;
+    p.pending = true;
+    if (!batched) writeParam(*session.protocol, p);
+    sent++;
+  }
+  if (batched) session.protocol->writeAll(batch);
+  return sent;
+}
 
-  protocol->onLogReceived = [&](uint8_t level, const std::string& msg) {
-    ctx.device.deviceLogs.push_back({level, msg, (double)GetTime()});
-    if (ctx.device.deviceLogs.size() > 100) ctx.device.deviceLogs.erase(ctx.device.deviceLogs.begin());
-    ctx.device.logScroll.y = -1000000;  // Auto-scroll
-  };
+bool Manager::setTelemetry(Session& session, bool enabled) {
+  if (!session.protocol || !session.protocol->getLinkConfig().supports(Protocol::kCapTelemetry)) return false;
+  if (!enabled) {
+    if (session.telemetryOn) session.protocol->unsubscribe();
+    session.telemetryOn = false;
+    return true;
+  }
+  std::vector<uint8_t> ids;
+  for (const auto& p : session.device.config) {
+    if (p.loaded && p.type != Protocol::ParamType::kString && p.id <= 0xFF) ids.push_back(static_cast<uint8_t>(p.id));
+  }
+  if (ids.empty()) return false;
+  session.protocol->subscribe(ids, kTelemetryPeriodUs);
+  session.telemetryOn = true;
+  return true;
+}
 
-  protocol->requestSchema();
+bool Manager::setLogLevel(Session& session, uint8_t minLevel) {
+  if (!session.protocol || !session.protocol->getLinkConfig().supports(Protocol::kCapLogTokens)) return false;
+  session.logLevel = minLevel;
+  session.protocol->setLogLevel(minLevel);
+  return true;
+}
+
+bool Manager::sendFile(Session& session, const std::string& path, uint8_t slot) {
+  if (!session.protocol || !session.protocol->getLinkConfig().supports(Protocol::kCapBlob)) return false;
+  if (session.protocol->isSendingBlob() || !session.blobFile.open(path)) return false;
+  if (!session.protocol->sendBlob(slot, session.blobFile.bytes())) {
+    session.blobFile.close();
+    return false;
+  }
+  return true;
+}
+
+void Manager::setupProtocol(Session& session) {
+  if (!session.comm->isOpen()) return;
+
+  if (session.bus) {
+    session.protocol = std::make_unique<ProtocolHandler>(*session.bus, session.busAddress);
+  } else {
+    session.protocol = std::make_unique<ProtocolHandler>(session.comm.get());
+  }
+  session.protocol->negotiate();
 }
 
 }  // namespace CommunicationManager
@@ -0,0 +1,119 @@
+#include "Crc.hpp"
+#include <array>
+#include <cstring>
+
+namespace Crc {
+
+namespace {
+
+// Slice-by-8 tables: table[k][v] is the CRC contribution of byte v followed by k zero bytes
+using Tables16 = std::array<std::array<uint16_t, 256>, 8>;
+using Tables32 = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr Tables16 MakeCrc16Tables() {
+  Tables16 t{};
+  for (uint32_t v = 0; v < 256; v++) {
+    uint16_t crc = static_cast<uint16_t>(v << 8);
+    for (int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : crc << 1;
+    t[0][v] = crc;
+  }
+  for (int k = 1; k < 8; k++) {
+    for (int v = 0; v < 256; v++) {
+      uint16_t prev = t[k - 1][v];
+      t[k][v] = static_cast<uint16_t>((prev << 8) ^ t[0][prev >> 8]);
+    }
+  }
+  return t;
+}
+
+constexpr Tables32 MakeCrc32cTables() {
+  Tables32 t{};
+  for (uint32_t v = 0; v < 256; v++) {
+    uint32_t crc = v;
+    for (int bit = 0; bit < 8; bit++) crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+    t[0][v] = crc;
+  }
+  for (int k = 1; k < 8; k++) {
+    for (int v = 0; v < 256; v++) {
+      uint32_t prev = t[k - 1][v];
+      t[k][v] = (prev >> 8) ^ t[0][prev & 0xFF];
+    }
+  }
+  return t;
+}
+
+constexpr Tables16 kCrc16Tables = MakeCrc16Tables();
+constexpr Tables32 kCrc32cTables = MakeCrc32cTables();
+
+inline uint32_t Load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;  // little endian host assumed, as everywhere in the protocol code
+}
+
+uint32_t Crc32cSlice8(const uint8_t* p, std::size_t n, uint32_t crc) {
+  const auto& t = kCrc32cTables;
+  while (n >= 8) {
+    uint32_t lo = Load32(p) ^ crc;
+    uint32_t hi = Load32(p + 4);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^ t[3][hi & 0xFF] ^
+          t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+    n -= 8;
+  }
+  while (n--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ZONAI_HAVE_SSE42_CRC 1
+
+__attribute__((target("sse4.2"))) uint32_t Crc32cSse42(const uint8_t* p, std::size_t n, uint32_t crc) {
+  uint64_t c = crc;
+  while (n >= 8) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    c = __builtin_ia32_crc32di(c, v);
+    p += 8;
+    n -= 8;
+  }
+  uint32_t c32 = static_cast<uint32_t>(c);
+  while (n--) c32 = __builtin_ia32_crc32qi(c32, *p++);
+  return c32;
+}
+#endif
+
+using Crc32cKernel = uint32_t (*)(const uint8_t*, std::size_t, uint32_t);
+
+Crc32cKernel SelectCrc32cKernel() {
+#ifdef ZONAI_HAVE_SSE42_CRC
+  if (__builtin_cpu_supports("sse4.2")) return Crc32cSse42;
+#endif
+  return Crc32cSlice8;
+}
+
+const Crc32cKernel kCrc32cKernel = SelectCrc32cKernel();
+
+}  // namespace
+
+uint16_t Crc16Ccitt(std::span<const uint8_t> data, uint16_t crc) {
+  const auto& t = kCrc16Tables;
+  const uint8_t* p = data.data();
+  std::size_t n = data.size();
+  while (n >= 8) {
+    crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xFF)] ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^
+          t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    n -= 8;
+  }
+  while (n--) crc = static_cast<uint16_t>((crc << 8) ^ t[0][(crc >> 8) ^ *p++]);
+  return crc;
+}
+
+uint32_t Crc32c(std::span<const uint8_t> data, uint32_t crc) {
+  return ~kCrc32cKernel(data.data(), data.size(), ~crc);
+}
+
+const char* Crc32cImplementation() { return kCrc32cKernel == Crc32cSlice8 ? "slice-by-8" : "sse4.2"; }
+
+}  // namespace Crc
@@ -0,0 +1,215 @@
+#include "IoLoop.hpp"
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include "Log.hpp"
+
+std::size_t IoChannel::read(std::span<uint8_t> buffer) {
+  std::size_t n = rx.pop(buffer.data(), buffer.size());
+  // Pairs with the fence in IoLoop::drainRx: either the loop sees this pop when
+  // it re-checks for room, or this load sees it paused
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (n > 0 && rxPaused.load(std::memory_order_relaxed) && loop) loop->wake();
+  return n;
+}
+
+std::size_t IoChannel::write(std::span<const uint8_t> data) {
+  if (hasFailed()) return 0;
+  std::size_t n = tx.push(data.data(), data.size());
+  if (n > 0 && loop) loop->wake();
+  return n;
+}
+
+std::size_t IoChannel::writev(std::span<const std::span<const uint8_t>> chunks) {
+  if (hasFailed()) return 0;
+  std::size_t total = 0;
+  for (auto chunk : chunks) total += chunk.size();
+  // Only this thread produces, so free space can only grow after the check
+  if (total == 0 || tx.capacity() - tx.size() < total) return 0;
+  for (auto chunk : chunks) tx.push(chunk.data(), chunk.size());
+  if (loop) loop->wake();
+  return total;
+}
+
+IoLoop::IoLoop() {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd < 0 || wakeFd < 0) {
+    Log::Serial::Error() << "Failed to create I/O loop: " << std::strerror(errno);
+    return;
+  }
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;  // nullptr marks the wake eventfd
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+  running = true;
+  thread = std::thread(&IoLoop::run, this);
+}
+
+IoLoop::~IoLoop() {
+  if (running.exchange(false)) {
+    uint64_t one = 1;
+    ::write(wakeFd, &one, sizeof(one));
+    thread.join();
+  }
+  if (wakeFd >= 0) ::close(wakeFd);
+  if (epollFd >= 0) ::close(epollFd);
+}
+
+bool IoLoop::attach(IoChannel& channel, int fd) {
+  if (!isRunning()) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  channel.fd = fd;
+  channel.loop = this;
+  channel.interest = EPOLLIN | EPOLLRDHUP;
+  channel.rxPaused = false;
+  channel.failed = false;
+  channel.rx.clear();
+  channel.tx.clear();
+
+  epoll_event ev{};
+  ev.events = channel.interest;
+  ev.data.ptr = &channel;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    Log::Serial::Error() << "epoll_ctl(ADD) failed: " << std::strerror(errno);
+    channel.loop = nullptr;
+    return false;
+  }
+  channels.push_back(&channel);
+  return true;
+}
+
+void IoLoop::detach(IoChannel& channel) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = std::find(channels.begin(), channels.end(), &channel);
+  if (it == channels.end()) return;
+  if (!channel.hasFailed()) epoll_ctl(epollFd, EPOLL_CTL_DEL, channel.fd, nullptr);
+  channels.erase(it);
+  channel.loop = nullptr;
+}
+
+void IoLoop::wake() {
+  if (wakePending.exchange(true, std::memory_order_acq_rel)) return;  // already signalled
+  uint64_t one = 1;
+  ::write(wakeFd, &one, sizeof(one));
+}
+
+void IoLoop::run() {
+  constexpr int kMaxEvents = 16;
+  epoll_event events[kMaxEvents];
+
+  // A socket peer can vanish mid-write; take that as EPIPE (channel failure)
+  // rather than a SIGPIPE that would kill the whole process
+  sigset_t blocked;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+
+  while (running.load(std::memory_order_acquire)) {
+    int n = epoll_wait(epollFd, events, kMaxEvents, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      Log::Serial::Error() << "epoll_wait failed: " << std::strerror(errno);
+      break;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    bool woken = false;
+    for (int i = 0; i < n; ++i) {
+      auto* ch = static_cast<IoChannel*>(events[i].data.ptr);
+      if (!ch) {
+        uint64_t count;
+        ::read(wakeFd, &count, sizeof(count));
+        woken = true;
+        continue;
+      }
+      // Events from a channel detached earlier in this batch are stale
+      if (std::find(channels.begin(), channels.end(), ch) == channels.end() || ch->hasFailed()) continue;
+
+      uint32_t ev = events[i].events;
+      if (ev & EPOLLIN) drainRx(*ch);
+      if (ev & EPOLLOUT) flushTx(*ch);
+      if (ev & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) fail(*ch);
+    }
+
+    if (woken) {
+      // Clear before scanning so writes racing with the scan signal again
+      wakePending.store(false, std::memory_order_release);
+      for (IoChannel* ch : channels) {
+        if (ch->hasFailed()) continue;
+        if (ch->rxPaused.load(std::memory_order_acquire) && !ch->rx.full()) drainRx(*ch);
+        if (!ch->tx.empty()) flushTx(*ch);
+      }
+    }
+  }
+}
+
+void IoLoop::drainRx(IoChannel& ch) {
+  while (true) {
+    std::span<uint8_t> seg = ch.rx.writeSegment();
+    if (seg.empty()) {
+      // Ring full: stop polling for input until the consumer catches up
+      ch.rxPaused.store(true, std::memory_order_relaxed);
+      setInterest(ch, ch.interest & ~EPOLLIN);
+      // The consumer may have emptied the ring before it could see the flag,
+      // and then it never wakes us; look again now that the flag is visible
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      seg = ch.rx.writeSegment();
+      if (seg.empty()) return;
+    }
+    ssize_t r = ::read(ch.fd, seg.data(), seg.size());
+    if (r > 0) {
+      ch.rx.commit(static_cast<std::size_t>(r));
+      continue;
+    }
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      fail(ch);
+      return;
+    }
+    break;  // kernel buffer empty
+  }
+  if (ch.rxPaused.exchange(false)) setInterest(ch, ch.interest | EPOLLIN);
+}
+
+void IoLoop::flushTx(IoChannel& ch) {
+  while (!ch.tx.empty()) {
+    std::span<const uint8_t> seg = ch.tx.readSegment();
+    ssize_t w = ::write(ch.fd, seg.data(), seg.size());
+    if (w > 0) {
+      ch.tx.consume(static_cast<std::size_t>(w));
+      continue;
+    }
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // Kernel queue full: resume when the fd becomes writable
+      setInterest(ch, ch.interest | EPOLLOUT);
+      return;
+    }
+    fail(ch);
+    return;
+  }
+  if (ch.interest & EPOLLOUT) setInterest(ch, ch.interest & ~EPOLLOUT);
+}
+
+void IoLoop::setInterest(IoChannel& ch, uint32_t events) {
+  if (events == ch.interest) return;
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.ptr = &ch;
+  if (epoll_ctl(epollFd, EPOLL_CTL_MOD, ch.fd, &ev) == 0) ch.interest = events;
+}
+
+void IoLoop::fail(IoChannel& ch) {
+  if (ch.failed.exchange(true)) return;
+  Log::Serial::Error() << "Channel on fd " << ch.fd << " hung up or failed";
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, ch.fd, nullptr);
+}
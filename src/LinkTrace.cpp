@@ -0,0 +1,251 @@
+#include "LinkTrace.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include "Log.hpp"
+
+namespace LinkTrace {
+
+namespace {
+
+uint64_t monotonicNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool writeAll(int fd, const uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+template <typename T>
+std::span<const uint8_t> bytesOf(const T& value) {
+  return {reinterpret_cast<const uint8_t*>(&value), sizeof(T)};
+}
+
+}  // namespace
+
+// --- Writer ---
+
+Writer::~Writer() { close(); }
+
+bool Writer::open(const std::string& path) {
+  close();
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    Log::Trace::Error() << "Cannot create " << path << ": " << std::strerror(errno);
+    return false;
+  }
+
+  filePath = path;
+  startNs = monotonicNs();
+  lastFlushNs = 0;
+  recordCount = 0;
+  lastTimeNs = 0;
+  index.clear();
+  buffer.clear();
+  buffer.reserve(kBufferSize);
+
+  FileHeader header{};
+  std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.startNs = startNs;
+  put(bytesOf(header));
+  offset = sizeof(header);
+  nextIndexOffset = offset;
+  return true;
+}
+
+void Writer::close() {
+  if (fd < 0) return;
+
+  Footer footer{};
+  footer.indexOffset = offset;
+  footer.indexCount = index.size();
+  footer.recordCount = recordCount;
+  footer.endNs = lastTimeNs;
+  std::memcpy(footer.magic, kFooterMagic, sizeof(footer.magic));
+  for (const auto& entry : index) put(bytesOf(entry));
+  put(bytesOf(footer));
+  flushBuffer();
+
+  ::close(fd);
+  fd = -1;
+  Log::Trace::Info() << "Closed " << filePath << " (" << recordCount << " records)";
+}
+
+void Writer::append(Direction direction, std::span<const uint8_t> data) {
+  if (fd < 0 || data.empty()) return;
+  beginRecord(direction, data.size());
+  put(data);
+}
+
+void Writer::append(Direction direction, std::span<const std::span<const uint8_t>> chunks) {
+  if (fd < 0) return;
+  std::size_t total = 0;
+  for (auto chunk : chunks) total += chunk.size();
+  if (total == 0) return;
+  beginRecord(direction, total);
+  for (auto chunk : chunks) put(chunk);
+}
+
+void Writer::beginRecord(Direction direction, std::size_t length) {
+  uint64_t now = monotonicNs();
+  lastTimeNs = now - startNs;
+
+  if (offset >= nextIndexOffset) {
+    index.push_back({lastTimeNs, offset});
+    nextIndexOffset = offset + kIndexStride;
+  }
+
+  RecordHeader header{lastTimeNs, static_cast<uint8_t>(direction), static_cast<uint32_t>(length)};
+  put(bytesOf(header));
+  offset += sizeof(header) + length;
+  recordCount++;
+
+  flushIfDue(now);
+}
+
+void Writer::poll() {
+  if (fd >= 0) flushIfDue(monotonicNs());
+}
+
+// Keeps at most a second of traffic in memory so a crash loses little
+void Writer::flushIfDue(uint64_t now) {
+  if (now - lastFlushNs <= kFlushIntervalNs) return;
+  flushBuffer();
+  lastFlushNs = now;
+}
+
+void Writer::put(std::span<const uint8_t> bytes) {
+  if (buffer.size() + bytes.size() > kBufferSize) flushBuffer();
+  if (bytes.size() >= kBufferSize) {
+    if (!writeAll(fd, bytes.data(), bytes.size())) Log::Trace::Error() << "Write failed: " << std::strerror(errno);
+    return;
+  }
+  buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+}
+
+void Writer::flushBuffer() {
+  if (buffer.empty() || fd < 0) return;
+  if (!writeAll(fd, buffer.data(), buffer.size())) Log::Trace::Error() << "Write failed: " << std::strerror(errno);
+  buffer.clear();
+}
+
+// --- Reader ---
+
+Reader::~Reader() { close(); }
+
+bool Reader::open(const std::string& path) {
+  close();
+  if (!file.open(path)) return false;
+  if (file.bytes().size() < sizeof(FileHeader)) {
+    Log::Trace::Error() << path << " is not a link trace";
+    close();
+    return false;
+  }
+
+  FileHeader header;
+  std::memcpy(&header, file.bytes().data(), sizeof(header));
+  if (std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) != 0 || header.version != kVersion) {
+    Log::Trace::Error() << path << " is not a link trace (or an unsupported version)";
+    close();
+    return false;
+  }
+
+  hadFooter = loadFooter();
+  if (!hadFooter) {
+    Log::Trace::Warning() << path << " has no index (capture was not closed); scanning";
+    scan();
+  }
+  return true;
+}
+
+void Reader::close() {
+  file.close();
+  dataEnd = 0;
+  records = 0;
+  endNs = 0;
+  hadFooter = false;
+  index.clear();
+}
+
+bool Reader::loadFooter() {
+  std::span<const uint8_t> bytes = file.bytes();
+  if (bytes.size() < sizeof(FileHeader) + sizeof(Footer)) return false;
+
+  Footer footer;
+  std::memcpy(&footer, bytes.data() + bytes.size() - sizeof(footer), sizeof(footer));
+  if (std::memcmp(footer.magic, kFooterMagic, sizeof(footer.magic)) != 0) return false;
+
+  uint64_t indexBytes = footer.indexCount * sizeof(IndexEntry);
+  if (footer.indexOffset < sizeof(FileHeader) || footer.indexOffset + indexBytes + sizeof(footer) != bytes.size()) {
+    return false;
+  }
+
+  index.resize(footer.indexCount);
+  if (indexBytes > 0) std::memcpy(index.data(), bytes.data() + footer.indexOffset, indexBytes);
+  dataEnd = footer.indexOffset;
+  records = footer.recordCount;
+  endNs = footer.endNs;
+  return true;
+}
+
+void Reader::scan() {
+  // Provisional end; next() trims at the first incomplete record
+  dataEnd = file.bytes().size();
+  uint64_t offset = begin();
+  uint64_t nextIndexOffset = offset;
+  Record record;
+  while (true) {
+    uint64_t recordOffset = offset;
+    if (!next(offset, record)) break;
+    if (recordOffset >= nextIndexOffset) {
+      index.push_back({record.timeNs, recordOffset});
+      nextIndexOffset = recordOffset + kIndexStride;
+    }
+    records++;
+    endNs = record.timeNs;
+  }
+  dataEnd = offset;
+}
+
+bool Reader::next(uint64_t& offset, Record& record) const {
+  if (offset + sizeof(RecordHeader) > dataEnd) return false;
+  const uint8_t* map = file.bytes().data();
+  RecordHeader header;
+  std::memcpy(&header, map + offset, sizeof(header));
+  uint64_t end = offset + sizeof(header) + header.length;
+  if (end > dataEnd) return false;
+
+  record.timeNs = header.timeNs;
+  record.direction = static_cast<Direction>(header.direction);
+  record.data = {map + offset + sizeof(header), header.length};
+  offset = end;
+  return true;
+}
+
+uint64_t Reader::seek(uint64_t timeNs) const {
+  auto it = std::upper_bound(index.begin(), index.end(), timeNs,
+                             [](uint64_t t, const IndexEntry& entry) { return t < entry.timeNs; });
+  uint64_t offset = (it == index.begin()) ? begin() : std::prev(it)->offset;
+
+  Record record;
+  for (uint64_t cursor = offset; next(cursor, record); offset = cursor) {
+    if (record.timeNs >= timeNs) break;
+  }
+  return offset;
+}
+
+}  // namespace LinkTrace
@@ -1,9 +1,14 @@
 #include "LinuxSerialPort.hpp"
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <cerrno>
 #include <cstring>
 #include <filesystem>
 #include <iostream>
+#include "Log.hpp"
 
-LinuxSerialPort::LinuxSerialPort() : fd(-1) {}
+LinuxSerialPort::LinuxSerialPort(IoLoop* sharedLoop) : fd(-1), sharedLoop(sharedLoop) {}
 
 LinuxSerialPort::~LinuxSerialPort() { close(); }
 
@@ -16,17 +21,23 @@ bool LinuxSerialPort::open(const std::string& port, int baudRate) {
     return false;
   }
 
-  if (tcgetattr(fd, &tty) != 0) {
-    perror("Error from tcgetattr");
+  // termios2 lets us program any integer rate (BOTHER) instead of the Bxxx table
+  struct termios2 tty;
+  if (ioctl(fd, TCGETS2, &tty) != 0) {
+    perror("Error from TCGETS2");
+    close();
     return false;
   }
 
-  speed_t baud = translateBaud(baudRate);
-  cfsetospeed(&tty, baud);
-  cfsetispeed(&tty, baud);
+  unsigned int baud = translateBaud(baudRate);
+  tty.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  tty.c_cflag |= baud | (baud << IBSHIFT);
+  tty.c_ispeed = static_cast<speed_t>(baudRate);
+  tty.c_ospeed = static_cast<speed_t>(baudRate);
 
   tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;  // 8-bit chars
-  tty.c_iflag &= ~IGNBRK;                      // disable break processing
+  tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK);  // disable break processing
+  tty.c_iflag &= ~(ISTRIP | INLCR | IGNCR | ICRNL);  // pass binary bytes through untouched
   tty.c_lflag = 0;                             // no signaling chars, no echo,
                                                // no canonical processing
   tty.c_oflag = 0;                             // no remapping, no delays
@@ -41,8 +52,24 @@ bool LinuxSerialPort::open(const std::string& port, int baudRate) {
   tty.c_cflag &= ~CSTOPB;
   tty.c_cflag &= ~CRTSCTS;
 
-  if (tcsetattr(fd, TCSANOW, &tty) != 0) {
-    perror("Error from tcsetattr");
+  if (ioctl(fd, TCSETS2, &tty) != 0) {
+    perror("Error from TCSETS2");
+    close();
+    return false;
+  }
+
+  // Drivers round custom rates to what their divisors can do; report the result
+  if (ioctl(fd, TCGETS2, &tty) == 0 && tty.c_ospeed != static_cast<speed_t>(baudRate)) {
+    Log::Serial::Warning() << port << ": requested " << baudRate << " baud, driver set " << tty.c_ospeed;
+  }
+
+  if (lowLatency) applyLowLatency(port);
+
+  // Hand the fd to the I/O thread; read()/write() now only touch the channel rings
+  if (!sharedLoop) ownLoop = std::make_unique<IoLoop>();
+  ioLoop = sharedLoop ? sharedLoop : ownLoop.get();
+  if (!ioLoop->attach(channel, fd)) {
+    close();
     return false;
   }
 
@@ -50,29 +77,32 @@ bool LinuxSerialPort::open(const std::string& port, int baudRate) {
 }
 
 void LinuxSerialPort::close() {
-  if (isOpen()) {
+  if (ioLoop) {
+    ioLoop->detach(channel);
+    ioLoop = nullptr;
+    ownLoop.reset();  // joins a private I/O thread
+  }
+  if (fd >= 0) {
     ::close(fd);
     fd = -1;
   }
 }
 
-bool LinuxSerialPort::isOpen() const { return fd >= 0; }
+bool LinuxSerialPort::isOpen() const { return fd >= 0 && !channel.hasFailed(); }
 
-std::size_t LinuxSerialPort::write(const std::vector<uint8_t>& data) {
+std::size_t LinuxSerialPort::read(std::span<uint8_t> buffer) {
   if (!isOpen()) return 0;
-  ssize_t bytesWritten = ::write(fd, data.data(), data.size());
-  return bytesWritten > 0 ? static_cast<std::size_t>(bytesWritten) : 0;
+  return channel.read(buffer);
 }
 
-std::vector<uint8_t> LinuxSerialPort::read(std::size_t maxSize) {
-  if (!isOpen()) return {};
-  std::vector<uint8_t> buffer(maxSize);
-  ssize_t bytesRead = ::read(fd, buffer.data(), maxSize);
-  if (bytesRead > 0) {
-    buffer.resize(bytesRead);
-    return buffer;
-  }
-  return {};
+std::size_t LinuxSerialPort::write(std::span<const uint8_t> data) {
+  if (!isOpen()) return 0;
+  return channel.write(data);
+}
+
+std::size_t LinuxSerialPort::writev(std::span<const std::span<const uint8_t>> chunks) {
+  if (!isOpen()) return 0;
+  return channel.writev(chunks);
 }
 
 std::vector<std::string> LinuxSerialPort::listPorts() {
@@ -86,7 +116,21 @@ std::vector<std::string> LinuxSerialPort::listPorts() {
   return ports;
 }
 
-speed_t LinuxSerialPort::translateBaud(int baudRate) {
+void LinuxSerialPort::applyLowLatency(const std::string& port) {
+  // Asks USB-serial drivers (ftdi_sio, cp210x...) to skip their RX latency timer.
+  // Devices without the ioctl (cdc-acm, pty) are already unbuffered.
+  struct serial_struct serial;
+  if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+    Log::Serial::Debug() << port << ": low-latency flag not supported by driver";
+    return;
+  }
+  serial.flags |= ASYNC_LOW_LATENCY;
+  if (ioctl(fd, TIOCSSERIAL, &serial) != 0) {
+    Log::Serial::Warning() << port << ": failed to set ASYNC_LOW_LATENCY: " << std::strerror(errno);
+  }
+}
+
+unsigned int LinuxSerialPort::translateBaud(int baudRate) {
   switch (baudRate) {
     case 9600:
       return B9600;
@@ -98,7 +142,33 @@ speed_t LinuxSerialPort::translateBaud(int baudRate) {
       return B57600;
     case 115200:
       return B115200;
+    case 230400:
+      return B230400;
+    case 460800:
+      return B460800;
+    case 500000:
+      return B500000;
+    case 576000:
+      return B576000;
+    case 921600:
+      return B921600;
+    case 1000000:
+      return B1000000;
+    case 1152000:
+      return B1152000;
+    case 1500000:
+      return B1500000;
+    case 2000000:
+      return B2000000;
+    case 2500000:
+      return B2500000;
+    case 3000000:
+      return B3000000;
+    case 3500000:
+      return B3500000;
+    case 4000000:
+      return B4000000;
     default:
-      return B9600;
+      return BOTHER;  // arbitrary rate carried in c_ispeed/c_ospeed
   }
 }
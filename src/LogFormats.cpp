@@ -0,0 +1,78 @@
+#include "LogFormats.hpp"
+#include <cstdio>
+
+namespace Protocol {
+
+std::string FormatLog(std::string_view format, std::span<const uint8_t> args) {
+  std::string out;
+  out.reserve(format.size() + 16);
+  std::size_t offset = 0;
+  char number[32];
+  for (std::size_t i = 0; i < format.size(); i++) {
+    if (format[i] != '%' || i + 1 == format.size()) {
+      out += format[i];
+      continue;
+    }
+    char spec = format[++i];
+    switch (spec) {
+      case 'd': {
+        int32_t v;
+        out += Wire::Scalar<int32_t>::load(args, offset, v) ? std::to_string(v) : "?";
+        break;
+      }
+      case 'u': {
+        uint32_t v;
+        out += Wire::U32::load(args, offset, v) ? std::to_string(v) : "?";
+        break;
+      }
+      case 'g': {
+        float v;
+        if (Wire::F32::load(args, offset, v)) {
+          std::snprintf(number, sizeof(number), "%g", v);
+          out += number;
+        } else {
+          out += '?';
+        }
+        break;
+      }
+      case 's': {
+        std::string_view v;
+        if (Wire::Str8::load(args, offset, v)) {
+          out += v;
+        } else {
+          out += '?';
+        }
+        break;
+      }
+      case '%':
+        out += '%';
+        break;
+      default:  // not a placeholder; kept as written
+        out += '%';
+        out += spec;
+        break;
+    }
+  }
+  return out;
+}
+
+void LogFormats::load(LogFormatsView view) {
+  formats.clear();
+  for (const auto& entry : view) {
+    if (entry.id >= formats.size()) formats.resize(entry.id + 1);
+    formats[entry.id] = entry.format;
+  }
+}
+
+std::string LogFormats::render(uint8_t id, std::span<const uint8_t> args) const {
+  if (id < formats.size() && !formats[id].empty()) return FormatLog(formats[id], args);
+  std::string out = "format " + std::to_string(id);
+  char hex[4];
+  for (uint8_t b : args) {
+    std::snprintf(hex, sizeof(hex), " %02x", b);
+    out += hex;
+  }
+  return out;
+}
+
+}  // namespace Protocol
@@ -0,0 +1,112 @@
+#include "Lz.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Lz {
+
+namespace {
+
+uint32_t hash3(const uint8_t* p, std::size_t bits) {
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (v * 2654435761u) >> (32 - bits);
+}
+
+}  // namespace
+
+Encoder::Encoder() : head(std::size_t{1} << kHashBits, -1), prev(kWindow, -1) {}
+
+std::size_t Encoder::encode(std::span<const uint8_t> in, std::span<uint8_t> out) {
+  std::fill(head.begin(), head.end(), -1);
+  const uint8_t* src = in.data();
+  const std::size_t n = in.size();
+  // Stop one byte short of the input size: equal size is no gain
+  const std::size_t limit = std::min(out.size(), n == 0 ? 0 : n - 1);
+
+  std::size_t o = 0;
+  std::size_t flagAt = 0;
+  int items = 8;  // forces a new flag byte first
+
+  auto insert = [&](std::size_t pos) {
+    if (pos + kMinMatch > n) return;
+    uint32_t h = hash3(src + pos, kHashBits);
+    prev[pos % kWindow] = head[h];
+    head[h] = static_cast<int32_t>(pos);
+  };
+
+  std::size_t pos = 0;
+  while (pos < n) {
+    if (items == 8) {
+      if (o >= limit) return 0;
+      flagAt = o;
+      out[o++] = 0;
+      items = 0;
+    }
+
+    // Longest match among the most recent candidates with the same hash
+    std::size_t bestLen = 0;
+    std::size_t bestDist = 0;
+    if (pos + kMinMatch <= n) {
+      std::size_t maxLen = std::min(kMaxMatch, n - pos);
+      int32_t cand = head[hash3(src + pos, kHashBits)];
+      for (int chain = 0; cand >= 0 && chain < kMaxChain; chain++) {
+        std::size_t dist = pos - static_cast<std::size_t>(cand);
+        if (dist > kWindow) break;
+        std::size_t len = 0;
+        while (len < maxLen && src[cand + len] == src[pos + len]) len++;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = dist;
+          if (len == maxLen) break;
+        }
+        int32_t next = prev[static_cast<std::size_t>(cand) % kWindow];
+        if (next >= cand) break;  // slot reused by a newer position
+        cand = next;
+      }
+    }
+
+    if (bestLen >= kMinMatch) {
+      if (o + 2 > limit) return 0;
+      uint16_t ref = static_cast<uint16_t>((bestDist - 1) | ((bestLen - kMinMatch) << 12));
+      std::memcpy(&out[o], &ref, 2);
+      o += 2;
+      out[flagAt] |= static_cast<uint8_t>(1u << items);
+      for (std::size_t i = 0; i < bestLen; i++) insert(pos + i);
+      pos += bestLen;
+    } else {
+      if (o + 1 > limit) return 0;
+      out[o++] = src[pos];
+      insert(pos);
+      pos++;
+    }
+    items++;
+  }
+  return o;
+}
+
+bool Decode(std::span<const uint8_t> in, std::vector<uint8_t>& out, std::size_t maxSize) {
+  out.clear();
+  std::size_t i = 0;
+  while (i < in.size()) {
+    uint8_t flags = in[i++];
+    for (int bit = 0; bit < 8 && i < in.size(); bit++) {
+      if (!(flags & (1u << bit))) {
+        if (out.size() >= maxSize) return false;
+        out.push_back(in[i++]);
+        continue;
+      }
+      if (i + 2 > in.size()) return false;
+      uint16_t ref;
+      std::memcpy(&ref, &in[i], 2);
+      i += 2;
+      std::size_t dist = (ref & 0x0FFF) + 1u;
+      std::size_t len = (ref >> 12) + kMinMatch;
+      if (dist > out.size() || out.size() + len > maxSize) return false;
+      // Byte by byte: a reference may overlap the bytes it produces
+      std::size_t from = out.size() - dist;
+      for (std::size_t k = 0; k < len; k++) out.push_back(out[from + k]);
+    }
+  }
+  return true;
+}
+
+}  // namespace Lz
@@ -0,0 +1,60 @@
+#include "MappedFile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include "Log.hpp"
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : map(std::exchange(other.map, nullptr)),
+      mapSize(std::exchange(other.mapSize, 0)),
+      filePath(std::move(other.filePath)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    map = std::exchange(other.map, nullptr);
+    mapSize = std::exchange(other.mapSize, 0);
+    filePath = std::move(other.filePath);
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    Log::App::Error() << "Cannot open " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    ::close(fd);
+    Log::App::Error() << path << " is not a regular, non-empty file";
+    return false;
+  }
+  std::size_t size = static_cast<std::size_t>(st.st_size);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping keeps the file alive
+  if (addr == MAP_FAILED) {
+    Log::App::Error() << "mmap failed for " << path << ": " << std::strerror(errno);
+    return false;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  map = static_cast<const uint8_t*>(addr);
+  mapSize = size;
+  filePath = path;
+  return true;
+}
+
+void MappedFile::close() {
+  if (map) munmap(const_cast<uint8_t*>(map), mapSize);
+  map = nullptr;
+  mapSize = 0;
+  filePath.clear();
+}
@@ -0,0 +1,222 @@
+#include "PacketParser.hpp"
+#include <algorithm>
+#include <cstring>
+#include "Log.hpp"
+
+PacketParser::PacketParser() : buffer(kCapacity) {}
+
+std::span<uint8_t> PacketParser::writeSpace() {
+  // Slide the partial packet to the front once the free tail gets short
+  if (head > 0 && buffer.size() - tail < kCapacity / 2) {
+    std::memmove(buffer.data(), buffer.data() + head, tail - head);
+    tail -= head;
+    scanned -= std::min(scanned, head);
+    head = 0;
+  }
+  return {buffer.data() + tail, buffer.size() - tail};
+}
+
+void PacketParser::commit(std::size_t n) { tail += std::min(n, buffer.size() - tail); }
+
+void PacketParser::reset() {
+  head = tail = scanned = 0;
+  state = State::kHunting;
+}
+
+void PacketParser::setLinkConfig(const Protocol::LinkConfig& config) {
+  // Called between packets, so the next byte starts a fresh packet in either framing
+  if (config.framing != link.framing) {
+    state = State::kHunting;
+    scanned = head;
+  }
+  link = config;
+}
+
+bool PacketParser::next(Packet& packet) {
+  return link.framing == Protocol::Framing::kCobs ? nextCobs(packet) : nextStartByte(packet);
+}
+
+bool PacketParser::nextStartByte(Packet& packet) {
+  while (true) {
+    if (state == State::kHunting) {
+      const uint8_t* start = buffer.data() + head;
+      const void* found = std::memchr(start, Protocol::kStartByte, tail - head);
+      if (!found) {
+        counters.droppedBytes += tail - head;
+        head = tail = scanned = 0;
+        return false;
+      }
+      std::size_t skipped = static_cast<const uint8_t*>(found) - start;
+      counters.droppedBytes += skipped;
+      head += skipped;
+      state = State::kHeader;
+    }
+
+    std::size_t headerSize = link.headerSize();
+    if (state == State::kHeader) {
+      if (tail - head < headerSize) return false;
+      Protocol::PacketHeader header;
+      std::memcpy(&header, buffer.data() + head, sizeof(header));
+      if (header.length > kMaxPayload) {
+        // Most likely a stray start byte; do not wait for a payload that never comes
+        counters.oversized++;
+        resync();
+        continue;
+      }
+      pendingCommand = header.command;
+      pendingLength = header.length;
+      state = State::kPayload;
+    }
+
+    std::size_t trailerSize = link.trailerSize();
+    std::size_t total = headerSize + pendingLength + trailerSize;
+    if (tail - head < total) {
+      // A legacy PING is shorter than the packet its header announces here, and
+      // its host sends nothing else until it is answered
+      return takeLegacyPing(head, packet) == LegacyMatch::kYes;
+    }
+
+    std::span<const uint8_t> header(buffer.data() + head, headerSize);
+    std::span<const uint8_t> payload(buffer.data() + head + headerSize, pendingLength);
+    uint32_t received = Protocol::LoadTrailer(link, buffer.data() + head + total - trailerSize);
+    if (received != Protocol::ComputeTrailer(link.integrity, header, payload)) {
+      if (takeLegacyPing(head, packet) == LegacyMatch::kYes) return true;
+      Log::Protocol::Error() << Protocol::IntegrityName(link.integrity) << " mismatch for command 0x" << std::hex
+                             << (int)pendingCommand;
+      counters.checksumErrors++;
+      resync();
+      continue;
+    }
+
+    uint8_t sequence = link.sequenced ? header.back() : 0;
+    uint8_t address = link.addressed ? header[sizeof(Protocol::PacketHeader)] : 0;
+    packet = {static_cast<Protocol::Command>(pendingCommand), payload, sequence, address};
+    head += total;
+    state = State::kHunting;
+    counters.packets++;
+    return true;
+  }
+}
+
+bool PacketParser::nextCobs(Packet& packet) {
+  while (true) {
+    std::size_t from = std::max(scanned, head);
+    const void* found = std::memchr(buffer.data() + from, Cobs::kDelimiter, tail - from);
+    if (!found) {
+      scanned = tail;
+      if (tail - head > kMaxFrame) {
+        // No valid frame is this long: drop what we have and skip to the next delimiter
+        if (state != State::kDiscarding) counters.oversized++;
+        counters.droppedBytes += tail - head;
+        head = tail = scanned = 0;
+        state = State::kDiscarding;
+      }
+      return false;
+    }
+
+    std::size_t end = static_cast<const uint8_t*>(found) - buffer.data();
+    std::size_t frameStart = head;
+    head = scanned = end + 1;
+    if (state == State::kDiscarding) {
+      counters.droppedBytes += end + 1 - frameStart;
+      state = State::kHunting;
+      continue;
+    }
+    if (end == frameStart) continue;  // idle delimiters between frames
+
+    std::span<const uint8_t> frame(buffer.data() + frameStart, end - frameStart);
+    uint8_t* decoded = buffer.data() + frameStart;
+    std::size_t size = 0;
+    if (Cobs::Decode(frame, decoded, size) && acceptFrame(decoded, size, packet)) {
+      counters.packets++;
+      return true;
+    }
+
+    // A legacy PING reads as a bad frame ending in its start byte, cut short by
+    // its command byte. Decoding in place never writes a frame's last byte.
+    if (frame.back() == Protocol::kStartByte) {
+      LegacyMatch match = takeLegacyPing(end - 1, packet);
+      if (match != LegacyMatch::kNo) counters.droppedBytes += end - 1 - frameStart;
+      if (match == LegacyMatch::kYes) {
+        scanned = head;
+        return true;
+      }
+      if (match == LegacyMatch::kPartial) {
+        // Wait for the rest; the delimiter is found again from the start byte
+        head = end - 1;
+        scanned = end;
+        return false;
+      }
+    }
+    counters.droppedBytes += end + 1 - frameStart;
+  }
+}
+
+bool PacketParser::acceptFrame(const uint8_t* data, std::size_t size, Packet& packet) {
+  std::size_t headerSize = link.headerSize();
+  std::size_t trailerSize = link.trailerSize();
+  Protocol::PacketHeader header;
+  if (size < headerSize + trailerSize) {
+    counters.framingErrors++;
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (header.startByte != Protocol::kStartByte || header.length > kMaxPayload ||
+      headerSize + header.length + trailerSize != size) {
+    counters.framingErrors++;
+    return false;
+  }
+
+  std::span<const uint8_t> headerBytes(data, headerSize);
+  std::span<const uint8_t> payload(data + headerSize, header.length);
+  if (Protocol::LoadTrailer(link, data + size - trailerSize) !=
+      Protocol::ComputeTrailer(link.integrity, headerBytes, payload)) {
+    Log::Protocol::Error() << Protocol::IntegrityName(link.integrity) << " mismatch for command 0x" << std::hex
+                           << (int)header.command;
+    counters.checksumErrors++;
+    return false;
+  }
+  uint8_t sequence = link.sequenced ? headerBytes.back() : 0;
+  uint8_t address = link.addressed ? data[sizeof(header)] : 0;
+  packet = {static_cast<Protocol::Command>(header.command), payload, sequence, address};
+  return true;
+}
+
+PacketParser::LegacyMatch PacketParser::takeLegacyPing(std::size_t at, Packet& packet) {
+  // A bus never leaves its fixed modes, and a legacy link parses the PING as is
+  bool negotiated = link.integrity != Protocol::Integrity::kXor || link.framing != Protocol::Framing::kStartByte ||
+                    link.sequenced;
+  if (link.addressed || !negotiated) return LegacyMatch::kNo;
+
+  // [start byte, kPing, length (2 or 3), 0, version, caps, (ext)] and the payload's XOR
+  const uint8_t* bytes = buffer.data() + at;
+  std::size_t available = tail - at;
+  const uint8_t expected[] = {Protocol::kStartByte, static_cast<uint8_t>(Protocol::Command::kPing), 0, 0,
+                              Protocol::kCapabilityVersion};
+  for (std::size_t i = 0; i < std::min(available, sizeof(expected)); i++) {
+    bool ok = i == 2 ? bytes[i] == 2 || bytes[i] == 3 : bytes[i] == expected[i];
+    if (!ok) return LegacyMatch::kNo;
+  }
+  if (available < sizeof(expected)) return LegacyMatch::kPartial;
+
+  std::size_t length = bytes[2];
+  std::size_t size = sizeof(Protocol::PacketHeader) + length + 1;
+  if (available < size) return LegacyMatch::kPartial;
+  std::span<const uint8_t> header(bytes, sizeof(Protocol::PacketHeader));
+  std::span<const uint8_t> payload(bytes + header.size(), length);
+  if (bytes[size - 1] != Protocol::ComputeTrailer(Protocol::Integrity::kXor, header, payload)) return LegacyMatch::kNo;
+
+  packet = {Protocol::Command::kPing, payload, 0, 0, true};
+  head = at + size;
+  state = State::kHunting;
+  counters.packets++;
+  counters.legacyPings++;
+  return LegacyMatch::kYes;
+}
+
+void PacketParser::resync() {
+  // Drop only the start byte: a real packet may begin inside the rejected bytes
+  head++;
+  counters.droppedBytes++;
+  state = State::kHunting;
+}
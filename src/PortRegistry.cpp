@@ -0,0 +1,131 @@
+#include "PortRegistry.hpp"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "Log.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string readAttribute(const fs::path& path) {
+  std::ifstream in(path);
+  std::string value;
+  std::getline(in, value);
+  return value;
+}
+
+}  // namespace
+
+PortRegistry::PortRegistry() {
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0 || inotify_add_watch(inotifyFd, "/dev", IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+    Log::Serial::Warning() << "Port hotplug watch unavailable: " << std::strerror(errno);
+  }
+  scan();
+}
+
+PortRegistry::~PortRegistry() {
+  if (inotifyFd >= 0) ::close(inotifyFd);
+}
+
+bool PortRegistry::poll() {
+  if (inotifyFd < 0) return false;
+
+  alignas(inotify_event) char buffer[4096];
+  bool changed = false;
+  while (true) {
+    ssize_t len = ::read(inotifyFd, buffer, sizeof(buffer));
+    if (len <= 0) break;  // EAGAIN: nothing pending
+
+    for (char* p = buffer; p < buffer + len;) {
+      const auto* ev = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        // Events were lost; fall back to one full rescan
+        entries.clear();
+        scan();
+        changed = true;
+        continue;
+      }
+      if (ev->len == 0) continue;
+      std::string name = ev->name;
+      if (!isSerialName(name)) continue;
+
+      if (ev->mask & (IN_CREATE | IN_MOVED_TO)) changed |= add(name);
+      if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) changed |= remove(name);
+    }
+  }
+  return changed;
+}
+
+const PortInfo* PortRegistry::find(const std::string& path) const {
+  auto it = std::find_if(entries.begin(), entries.end(), [&](const PortInfo& p) { return p.path == path; });
+  return it != entries.end() ? &*it : nullptr;
+}
+
+void PortRegistry::scan() {
+  // /sys/class/tty lists only tty devices, far fewer entries than /dev
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator("/sys/class/tty", ec)) {
+    std::string name = entry.path().filename().string();
+    if (isSerialName(name)) add(name);
+  }
+  std::sort(entries.begin(), entries.end(), [](const PortInfo& a, const PortInfo& b) { return a.path < b.path; });
+}
+
+bool PortRegistry::add(const std::string& name) {
+  std::string path = "/dev/" + name;
+  if (find(path)) return false;
+
+  PortInfo info = readSysfs(name);
+  info.path = path;
+  Log::Serial::Info() << "Port added: " << path << " [" << info.vendorId << ":" << info.productId << " "
+                      << info.driver << (info.product.empty() ? "" : " " + info.product)
+                      << (info.serial.empty() ? "" : " sn " + info.serial) << "]";
+
+  auto pos = std::lower_bound(entries.begin(), entries.end(), path,
+                              [](const PortInfo& p, const std::string& v) { return p.path < v; });
+  entries.insert(pos, std::move(info));
+  return true;
+}
+
+bool PortRegistry::remove(const std::string& name) {
+  std::string path = "/dev/" + name;
+  auto it = std::find_if(entries.begin(), entries.end(), [&](const PortInfo& p) { return p.path == path; });
+  if (it == entries.end()) return false;
+  Log::Serial::Info() << "Port removed: " << path;
+  entries.erase(it);
+  return true;
+}
+
+bool PortRegistry::isSerialName(const std::string& name) {
+  return name.rfind("ttyUSB", 0) == 0 || name.rfind("ttyACM", 0) == 0;
+}
+
+PortInfo PortRegistry::readSysfs(const std::string& name) {
+  PortInfo info;
+  std::error_code ec;
+  fs::path device = fs::canonical(fs::path("/sys/class/tty") / name / "device", ec);
+  if (ec) return info;
+
+  fs::path driver = fs::read_symlink(device / "driver", ec);
+  if (!ec) info.driver = driver.filename().string();
+
+  // Walk up from the tty's interface to the USB device that owns the ids
+  for (fs::path dir = device; !dir.empty() && dir != dir.root_path(); dir = dir.parent_path()) {
+    if (fs::exists(dir / "idVendor", ec)) {
+      info.vendorId = readAttribute(dir / "idVendor");
+      info.productId = readAttribute(dir / "idProduct");
+      info.serial = readAttribute(dir / "serial");
+      info.product = readAttribute(dir / "product");
+      break;
+    }
+  }
+  return info;
+}
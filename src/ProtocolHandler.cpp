@@ -1,155 +1,464 @@
 #include "ProtocolHandler.hpp"
+#include <algorithm>
 #include <cstring>
 #include "Log.hpp"
 
-ProtocolHandler::ProtocolHandler(ICommunication* comm) : comm(comm) {}
+ProtocolHandler::ProtocolHandler(ICommunication* comm) : ownLine(std::make_unique<Line>(comm)), line(ownLine.get()) {}
 
-void ProtocolHandler::sendPing() { sendPacket(Protocol::Command::kPing); }
-void ProtocolHandler::requestSchema() { sendPacket(Protocol::Command::kGetSchema); }
-void ProtocolHandler::requestAllValues() { sendPacket(Protocol::Command::kReadAll); }
-
-void ProtocolHandler::writeValue(uint8_t id, float value) {
-  std::vector<uint8_t> payload;
-  payload.push_back(id);
-  uint8_t bytes[4];
-  std::memcpy(bytes, &value, 4);
-  payload.insert(payload.end(), bytes, bytes + 4);
-  sendPacket(Protocol::Command::kWriteValue, payload);
-}
-
-void ProtocolHandler::writeAll(const std::vector<float>& values) {
-  std::vector<uint8_t> payload;
-  payload.push_back(static_cast<uint8_t>(values.size()));
-  for (float v : values) {
-    uint8_t bytes[4];
-    std::memcpy(bytes, &v, 4);
-    payload.insert(payload.end(), bytes, bytes + 4);
-  }
-  sendPacket(Protocol::Command::kWriteAll, payload);
-}
-
-void ProtocolHandler::update() {
-  if (!comm || !comm->isOpen()) return;
-
-  // Read new data into buffer
-  std::vector<uint8_t> newData = comm->read(512);
-  rxBuffer.insert(rxBuffer.end(), newData.begin(), newData.end());
-
-  // Parse buffer for packets
-  while (rxBuffer.size() >= sizeof(Protocol::PacketHeader)) {
-    // Find start byte
-    if (rxBuffer[0] != Protocol::kStartByte) {
-      rxBuffer.erase(rxBuffer.begin());
-      continue;
-    }
+ProtocolHandler::ProtocolHandler(Bus& bus, uint8_t address) : line(&bus.line), bus(&bus), address(address) {
+  setLinkConfig(bus.getLinkConfig());
+  bus.attach(this);
+}
+
+ProtocolHandler::~ProtocolHandler() {
+  if (bus) bus->detach(this);
+}
+
+void ProtocolHandler::negotiate(uint16_t capabilities) {
+  if (!line->comm || !line->comm->isOpen()) return;
+  requests.clear();
+  blob.finish();  // a renegotiated device may not take blobs any more
+  if (bus) {
+    offeredCapabilities = capabilities & ~Protocol::kCapTelemetry;  // pushes would collide with other answers
+    pingQueued = true;
+    bus->schedule();
+    flush();
+    return;
+  }
+  offeredCapabilities = capabilities;
+  setLinkConfig({});  // offered in legacy framing, which a device takes in any mode as a fresh start
+  sendOffer();
+  flush();  // nothing else may go out until the device has answered
+}
 
-    const auto* header = reinterpret_cast<const Protocol::PacketHeader*>(rxBuffer.data());
-    std::size_t totalSize = sizeof(Protocol::PacketHeader) + header->length + 1;  // +1 for checksum
+void ProtocolHandler::sendOffer() {
+  uint8_t offer[Protocol::Wire::PingOffer::kSize];
+  Protocol::Wire::PingOffer::encode(offer, Protocol::kCapabilityVersion, static_cast<uint8_t>(offeredCapabilities),
+                                    static_cast<uint8_t>(offeredCapabilities >> 8));
+  sendPacket(Protocol::Command::kPing, offer);
+  pingQueued = false;
+  negotiating = true;
+  negotiationStart = std::chrono::steady_clock::now();
+}
 
-    if (rxBuffer.size() < totalSize) break;  // Wait for more data
+void ProtocolHandler::applyNegotiated(const Protocol::LinkConfig& config) {
+  negotiating = false;
+  setLinkConfig(config);
+  const Protocol::LinkConfig& applied = getLinkConfig();  // a bus drop keeps the bus's modes
+  Log::Protocol::Info() << (bus ? "Drop " + std::to_string(address) + ": link" : "Link")
+                        << " integrity: " << Protocol::IntegrityName(applied.integrity)
+                        << ", framing: " << Protocol::FramingName(applied.framing)
+                        << (applied.sequenced ? ", sequenced" : "")
+                        << (applied.supports(Protocol::kCapCompression) ? ", compressed" : "")
+                        << (applied.supports(Protocol::kCapPaged) ? ", paged" : "");
+}
 
-    // Extract payload
-    std::vector<uint8_t> payload(rxBuffer.begin() + sizeof(Protocol::PacketHeader), rxBuffer.begin() + totalSize - 1);
-    uint8_t receivedChecksum = rxBuffer[totalSize - 1];
+void ProtocolHandler::restartLegacy() {
+  Log::Protocol::Info() << "Legacy PING on a negotiated link, back to the legacy checksum";
+  setLinkConfig({});
+}
 
-    if (receivedChecksum == Protocol::CalculateChecksum(payload)) {
-      processPacket(*header, payload);
-    } else {
-      Log::Protocol::Error() << "Checksum mismatch for command 0x" << std::hex << (int)header->command;
+bool ProtocolHandler::negotiationTimedOut() {
+  if (!negotiating) return false;
+  if (std::chrono::steady_clock::now() - negotiationStart < std::chrono::milliseconds(kNegotiationTimeoutMs)) {
+    return false;
+  }
+  Log::Protocol::Warning() << "No answer to capability PING, keeping "
+                           << (bus ? "the bus modes" : "the legacy checksum");
+  return true;
+}
+
+bool ProtocolHandler::parsePingAnswer(std::span<const uint8_t> payload, Protocol::LinkConfig& config) {
+  Log::Protocol::Info() << "Ping/Ack received.";
+  if (!negotiating) return false;
+  // [ack, version, device caps, selected integrity, (selected framing, (schema hash, (extended caps)))];
+  // a bare [ack] is a legacy device
+  if (payload.size() >= 4 && payload[1] == Protocol::kCapabilityVersion &&
+      payload[3] <= static_cast<uint8_t>(Protocol::Integrity::kCrc32c)) {
+    config.integrity = static_cast<Protocol::Integrity>(payload[3]);
+    if (payload.size() >= 5 && payload[4] == static_cast<uint8_t>(Protocol::Framing::kCobs)) {
+      config.framing = Protocol::Framing::kCobs;
+    }
+    std::size_t offset = 5;
+    uint8_t extended = 0;
+    // Both optional; they stay 0 without them
+    if (Protocol::Wire::SchemaHash::decode(payload, offset, config.schemaHash)) {
+      Protocol::Wire::PingExtension::decode(payload, offset, extended);
     }
+    uint16_t deviceCaps = static_cast<uint16_t>(payload[2] | (extended << 8));
+    config.sequenced = Protocol::SelectSequenced(offeredCapabilities, deviceCaps);
+    config.commonCapabilities = offeredCapabilities & deviceCaps;
+  }
+  return true;
+}
 
-    rxBuffer.erase(rxBuffer.begin(), rxBuffer.begin() + totalSize);
+void ProtocolHandler::setLinkConfig(const Protocol::LinkConfig& config) {
+  linkConfig = config;
+  if (bus) {
+    const Protocol::LinkConfig& shared = bus->getLinkConfig();
+    linkConfig.integrity = shared.integrity;
+    linkConfig.framing = shared.framing;
+    linkConfig.sequenced = shared.sequenced;
+    linkConfig.addressed = shared.addressed;
+  } else {
+    line->rxParser.setLinkConfig(config);
+    line->txQueue.setLinkConfig(config);
   }
+  requests.setSequenced(linkConfig.sequenced);
 }
 
-void ProtocolHandler::sendPacket(Protocol::Command cmd, const std::vector<uint8_t>& payload) {
-  if (!comm || !comm->isOpen()) return;
+void ProtocolHandler::sendPing() { sendPacket(Protocol::Command::kPing); }
+void ProtocolHandler::requestSchema() { submitRequest(Protocol::Command::kGetSchema, {}); }
+void ProtocolHandler::requestAllValues() { submitRequest(Protocol::Command::kReadAll, {}); }
 
-  Protocol::PacketHeader header;
-  header.startByte = Protocol::kStartByte;
-  header.command = static_cast<uint8_t>(cmd);
-  header.length = static_cast<uint16_t>(payload.size());
+void ProtocolHandler::requestChanges(uint32_t sinceVersion) {
+  uint8_t payload[Protocol::Wire::Version::kSize];
+  Protocol::Wire::Version::encode(payload, sinceVersion);
+  submitRequest(Protocol::Command::kReadChanges, payload);
+}
 
-  std::vector<uint8_t> packet;
-  uint8_t* hPtr = reinterpret_cast<uint8_t*>(&header);
-  packet.insert(packet.end(), hPtr, hPtr + sizeof(header));
-  packet.insert(packet.end(), payload.begin(), payload.end());
-  packet.push_back(Protocol::CalculateChecksum(payload));
+void ProtocolHandler::refreshValues(uint32_t sinceVersion) {
+  if (getLinkConfig().supports(Protocol::kCapReadChanges)) {
+    requestChanges(sinceVersion);
+  } else {
+    requestAllValues();
+  }
+}
 
-  comm->write(packet);
+bool ProtocolHandler::canAddress(uint16_t id) const {
+  if (id <= 0xFF || getLinkConfig().supports(Protocol::kCapPaged)) return true;
+  Log::Protocol::Error() << "Parameter id " << id << " needs a paged link; write dropped";
+  return false;
 }
 
-void ProtocolHandler::writeString(uint8_t id, const std::string& value) {
-  std::vector<uint8_t> payload;
-  payload.push_back(id);
-  payload.push_back(static_cast<uint8_t>(value.length()));
-  payload.insert(payload.end(), value.begin(), value.end());
-  sendPacket(Protocol::Command::kWriteValue, payload);
+void ProtocolHandler::writeValue(uint16_t id, float value) {
+  if (!canAddress(id)) return;
+  if (id > 0xFF) {
+    uint8_t payload[Protocol::Wire::WideNumericValue::kSize];
+    Protocol::Wire::WideNumericValue::encode(payload, id, value);
+    submitRequest(Protocol::Command::kWriteValueWide, payload);
+    return;
+  }
+  uint8_t payload[Protocol::Wire::NumericValue::kSize];
+  Protocol::Wire::NumericValue::encode(payload, static_cast<uint8_t>(id), value);
+  submitRequest(Protocol::Command::kWriteValue, payload);
 }
 
-void ProtocolHandler::processPacket(const Protocol::PacketHeader& header, const std::vector<uint8_t>& payload) {
-  Protocol::Command cmd = static_cast<Protocol::Command>(header.command);
+void ProtocolHandler::requestSchemaPage(uint16_t first, uint8_t count) {
+  uint8_t payload[Protocol::Wire::PageRequest::kSize];
+  Protocol::Wire::PageRequest::encode(payload, first, count);
+  submitRequest(Protocol::Command::kGetSchemaPage, payload);
+}
 
-  // If we are in slave mode (simulator), trigger the command callback
-  if (onCommandReceived) {
-    onCommandReceived(cmd, payload);
+void ProtocolHandler::requestValuePage(uint16_t first, uint8_t count) {
+  uint8_t payload[Protocol::Wire::PageRequest::kSize];
+  Protocol::Wire::PageRequest::encode(payload, first, count);
+  submitRequest(Protocol::Command::kReadValuePage, payload);
+}
+
+void ProtocolHandler::subscribe(std::span<const uint8_t> ids, uint32_t periodUs) {
+  uint8_t payload[Protocol::Wire::SubscribeHeader::kSize + 255];
+  std::size_t count = std::min<std::size_t>(ids.size(), 255);
+  uint8_t* end = Protocol::Wire::SubscribeHeader::encode(payload, periodUs, static_cast<uint8_t>(count));
+  end = std::copy_n(ids.begin(), count, end);
+  submitRequest(Protocol::Command::kSubscribe, {payload, end});
+}
+
+void ProtocolHandler::unsubscribe(std::span<const uint8_t> ids) {
+  uint8_t payload[Protocol::Wire::Count::kSize + 255];
+  std::size_t count = std::min<std::size_t>(ids.size(), 255);
+  uint8_t* end = Protocol::Wire::Count::encode(payload, static_cast<uint8_t>(count));
+  end = std::copy_n(ids.begin(), count, end);
+  submitRequest(Protocol::Command::kUnsubscribe, {payload, end});
+}
+
+void ProtocolHandler::requestLogFormats() { submitRequest(Protocol::Command::kLogFormats, {}); }
+
+void ProtocolHandler::setLogLevel(uint8_t minLevel) {
+  uint8_t payload[Protocol::Wire::LogLevel::kSize];
+  Protocol::Wire::LogLevel::encode(payload, minLevel);
+  submitRequest(Protocol::Command::kSetLogLevel, payload);
+}
+
+void ProtocolHandler::submitRequest(Protocol::Command cmd, std::span<const uint8_t> payload) {
+  if (!line->comm || !line->comm->isOpen()) return;
+  if (requests.submit(cmd, payload)) sendRequests();
+}
+
+void ProtocolHandler::sendRequests() {
+  if (!line->comm || !line->comm->isOpen()) return;
+  if (bus) {
+    bus->schedule();
+  } else {
+    transmit(SIZE_MAX);
+  }
+}
+
+std::size_t ProtocolHandler::transmit(std::size_t newRequests) {
+  if (pingQueued) {
+    // The PING is a new request too; a spent grant waits for the next turn
+    if (newRequests == 0) return 0;
+    sendOffer();
+    return 1;
+  }
+  if (negotiating) return 0;
+  std::size_t sent = 0;
+  auto now = RequestTracker::Clock::now();
+  while (const RequestTracker::Request* request = requests.nextToSend(now, sent < newRequests)) {
+    line->txQueue.enqueue(request->command, request->payload, request->sequence, address);
+    if (request->attempts == 1) sent++;
+  }
+  // Blob chunks fill whatever the window has room for, after the requests
+  uint32_t offset;
+  std::span<const uint8_t> chunk;
+  while (sent < newRequests && blob.nextChunk(offset, chunk) && sendChunk(offset, chunk)) {
+    blob.sent(chunk.size(), now);
+    sent++;
+  }
+  return sent;
+}
+
+bool ProtocolHandler::hasWork(RequestTracker::Clock::time_point now) const {
+  uint32_t offset;
+  std::span<const uint8_t> chunk;
+  return pingQueued || (!negotiating && (requests.hasDue(now) || blob.nextChunk(offset, chunk)));
+}
+
+bool ProtocolHandler::sendBlob(uint8_t slot, std::span<const uint8_t> data) {
+  if (!line->comm || !line->comm->isOpen()) return false;
+  if (!getLinkConfig().supports(Protocol::kCapBlob)) {
+    Log::Protocol::Error() << "The device does not take blob transfers";
+    return false;
+  }
+  if (blob.active()) {
+    Log::Protocol::Error() << "A blob transfer is already running";
+    return false;
   }
+  if (data.empty() || data.size() > UINT32_MAX) {
+    Log::Protocol::Error() << "Cannot send a blob of " << data.size() << " bytes";
+    return false;
+  }
+  blob.start(slot, data);
+  uint8_t payload[Protocol::Wire::BlobOpen::kSize];
+  Protocol::Wire::BlobOpen::encode(payload, slot, static_cast<uint32_t>(data.size()), blob.getCrc());
+  submitRequest(Protocol::Command::kBlobOpen, payload);
+  return true;
+}
+
+bool ProtocolHandler::sendChunk(uint32_t offset, std::span<const uint8_t> bytes) {
+  TxQueue& tx = line->txQueue;
+  std::size_t length = Protocol::Wire::BlobChunkHeader::kSize + bytes.size();
+  if (!tx.fits(length)) tx.flush();
+  if (!tx.fits(length)) return false;  // the transport is backed up; the window waits
+  std::span<uint8_t> out = tx.beginPacket(Protocol::Command::kBlobChunk, length, 0, address);
+  uint8_t* end = Protocol::Wire::BlobChunkHeader::encode(out.data(), offset);
+  std::memcpy(end, bytes.data(), bytes.size());
+  tx.commitPacket();
+  return true;
+}
 
-  // Master mode logic (handling responses from device)
+ProtocolHandler::BlobEvent ProtocolHandler::advanceBlob(Protocol::Command cmd, std::span<const uint8_t> payload,
+                                                        Protocol::Wire::BlobStatus& status) {
+  using Protocol::Wire::BlobStatus;
+  std::size_t offset = 0;
+  auto now = BlobTransfer::Clock::now();
+  uint8_t code;
   switch (cmd) {
-    case Protocol::Command::kGetSchema: {
-      if (payload.empty()) return;
-      std::vector<DeviceParameter> schema;
-      uint8_t count = payload[0];
-      std::size_t offset = 1;
-      for (int i = 0; i < count; i++) {
-        DeviceParameter p;
-        p.id = payload[offset++];
-        p.type = static_cast<Protocol::ParamType>(payload[offset++]);
-        uint8_t nameLen = payload[offset++];
-        p.name = std::string(reinterpret_cast<const char*>(&payload[offset]), nameLen);
-        offset += nameLen;
-        std::memcpy(&p.min, &payload[offset], 4);
-        offset += 4;
-        std::memcpy(&p.max, &payload[offset], 4);
-        offset += 4;
-        p.value = p.min;  // Default
-        schema.push_back(p);
+    case Protocol::Command::kBlobOpen: {
+      uint32_t resumeAt;
+      uint16_t chunkBytes;
+      uint8_t windowChunks;
+      if (blob.getState() != BlobTransfer::State::kOpening ||
+          !Protocol::Wire::BlobOpenAck::decode(payload, offset, code, resumeAt, chunkBytes, windowChunks)) {
+        return BlobEvent::kNone;
+      }
+      status = static_cast<BlobStatus>(code);
+      if (status != BlobStatus::kOk) {
+        blob.finish();
+        return BlobEvent::kDone;
       }
-      if (onSchemaReceived) onSchemaReceived(schema);
+      blob.opened(resumeAt, chunkBytes, windowChunks, now);
+      Log::Protocol::Info() << "Sending " << blob.stats().total << " bytes to blob slot "
+                            << static_cast<int>(blob.getSlot())
+                            << (blob.stats().resumedAt ? ", resuming at " + std::to_string(blob.stats().resumedAt)
+                                                       : std::string());
       break;
     }
-    case Protocol::Command::kReadAll: {
-      if (payload.empty()) return;
-      std::vector<std::pair<uint8_t, float>> values;
-      uint8_t count = payload[0];
-      std::size_t offset = 1;
-      for (int i = 0; i < count; i++) {
-        uint8_t id = payload[offset++];
-        float val;
-        std::memcpy(&val, &payload[offset], 4);
-        offset += 4;
-        values.push_back({id, val});
+    case Protocol::Command::kBlobChunk: {
+      uint32_t received;
+      if (!Protocol::Wire::BlobChunkAck::decode(payload, offset, received) || !blob.acknowledged(received, now)) {
+        return BlobEvent::kNone;
       }
-      if (onValuesReceived) onValuesReceived(values);
       break;
     }
-    case Protocol::Command::kWriteValue: {
-      if (payload.size() >= 1) {
-        if (onWriteAck) onWriteAck(payload[0]);
+    case Protocol::Command::kBlobCommit:
+      if (blob.getState() != BlobTransfer::State::kCommitting ||
+          !Protocol::Wire::BlobCommitAck::decode(payload, offset, code)) {
+        return BlobEvent::kNone;
       }
+      status = static_cast<BlobStatus>(code);
+      blob.finish();
+      return BlobEvent::kDone;
+    default:
+      return BlobEvent::kNone;
+  }
+  if (blob.allAcknowledged()) {
+    blob.commit();
+    submitRequest(Protocol::Command::kBlobCommit, {});
+  }
+  return BlobEvent::kProgress;
+}
+
+ProtocolHandler::BlobEvent ProtocolHandler::checkBlob(RequestTracker::Clock::time_point now) {
+  switch (blob.checkStall(now, requests.stats().rtoMs)) {
+    case BlobTransfer::Stall::kNone:
+      return BlobEvent::kNone;
+    case BlobTransfer::Stall::kRewound:
+      Log::Protocol::Warning() << "Blob chunks unacknowledged, resending from byte " << blob.stats().acked;
+      return BlobEvent::kNone;
+    case BlobTransfer::Stall::kGaveUp:
       break;
+  }
+  Log::Protocol::Error() << "Blob transfer stalled at byte " << blob.stats().acked << " of " << blob.stats().total;
+  blob.finish();
+  return BlobEvent::kDone;
+}
+
+ProtocolHandler::BlobEvent ProtocolHandler::blobRequestFailed(const RequestTracker::Result& failed) {
+  bool blobRequest =
+      failed.command == Protocol::Command::kBlobOpen || failed.command == Protocol::Command::kBlobCommit;
+  if (!blobRequest || !blob.active()) return BlobEvent::kNone;
+  Log::Protocol::Error() << "Blob transfer abandoned: the device stopped answering";
+  blob.finish();
+  return BlobEvent::kDone;
+}
+
+void ProtocolHandler::writeAll(const Protocol::WriteBatch& batch) {
+  if (!batch.empty()) submitRequest(Protocol::Command::kWriteAll, batch.payload());
+}
+
+void ProtocolHandler::sendPacket(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence) {
+  sendPacket(cmd, payload, sequence, address);
+}
+
+void ProtocolHandler::sendPacket(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence,
+                                 uint8_t fromAddress) {
+  if (!line->comm || !line->comm->isOpen()) return;
+  if (payload.size() >= kMinCompressSize && getLinkConfig().supports(Protocol::kCapCompression) &&
+      cmd != Protocol::Command::kPing) {
+    deflated.resize(payload.size());
+    if (std::size_t size = compressor.encode(payload, deflated)) {
+      auto flagged = static_cast<Protocol::Command>(static_cast<uint8_t>(cmd) | Protocol::kCompressedFlag);
+      line->txQueue.enqueue(flagged, {deflated.data(), size}, sequence, fromAddress);
+      return;
     }
-    case Protocol::Command::kPing:
-      Log::Protocol::Info() << "Ping/Ack received.";
-      break;
-    case Protocol::Command::kLog: {
-      if (payload.size() >= 1) {
-        uint8_t level = payload[0];
-        std::string msg(reinterpret_cast<const char*>(&payload[1]), payload.size() - 1);
-        if (onLogReceived) onLogReceived(level, msg);
+  }
+  line->txQueue.enqueue(cmd, payload, sequence, fromAddress);
+}
+
+bool ProtocolHandler::expand(PacketParser::Packet& packet) {
+  auto command = static_cast<uint8_t>(packet.command);
+  if (!(command & Protocol::kCompressedFlag)) return true;
+  packet.command = static_cast<Protocol::Command>(command & ~Protocol::kCompressedFlag);
+  if (!Lz::Decode(packet.payload, inflated, PacketParser::kMaxPayload)) {
+    rxCompression.errors++;
+    Log::Protocol::Error() << "Corrupt compressed payload for command 0x" << std::hex
+                           << static_cast<int>(packet.command);
+    return false;
+  }
+  rxCompression.packets++;
+  rxCompression.wireBytes += packet.payload.size();
+  rxCompression.rawBytes += inflated.size();
+  packet.payload = inflated;
+  return true;
+}
+
+void ProtocolHandler::flush() {
+  if (!line->comm || !line->comm->isOpen()) return;
+  line->txQueue.flush();
+}
+
+void ProtocolHandler::writeString(uint16_t id, const std::string& value) {
+  if (!canAddress(id)) return;
+  uint8_t payload[Protocol::Wire::WideStringValue::kSize + 255];
+  if (id > 0xFF) {
+    uint8_t* end = Protocol::Wire::WideStringValue::encode(payload, id, value);
+    submitRequest(Protocol::Command::kWriteValueWide, {payload, end});
+    return;
+  }
+  uint8_t* end = Protocol::Wire::StringValue::encode(payload, static_cast<uint8_t>(id), value);
+  submitRequest(Protocol::Command::kWriteValue, {payload, end});
+}
+
+// --- Bus ---
+
+ProtocolHandler::Bus::Bus(ICommunication* comm, const Protocol::LinkConfig& config) : line(comm) {
+  line.rxParser.setLinkConfig(config);
+  line.txQueue.setLinkConfig(config);
+}
+
+void ProtocolHandler::Bus::attach(ProtocolHandler* drop) {
+  for (const ProtocolHandler* other : drops) {
+    if (other->address == drop->address) {
+      Log::Protocol::Warning() << "Two drops share bus address " << static_cast<int>(drop->address);
+    }
+  }
+  drops.push_back(drop);
+}
+
+void ProtocolHandler::Bus::detach(ProtocolHandler* drop) {
+  std::erase(drops, drop);
+  if (holder == drop) holder = nullptr;
+  nextDrop = 0;
+}
+
+void ProtocolHandler::Bus::poll() {
+  PacketParser::Packet packet;
+  while (true) {
+    std::size_t n = line.comm->read(line.rxParser.writeSpace());
+    line.rxParser.commit(n);
+    while (line.rxParser.next(packet)) {
+      auto drop = std::find_if(drops.begin(), drops.end(),
+                               [&](const ProtocolHandler* d) { return d->address == packet.address; });
+      if (drop == drops.end()) {
+        counters.strayPackets++;
+        Log::Protocol::Debug() << "Packet from bus address " << static_cast<int>(packet.address)
+                               << " with no session, dropped";
+        continue;
       }
+      // Copied: the parser reuses its buffer before the drop gets to handle it
+      ProtocolHandler& d = **drop;
+      if (&d == holder) extendHold(RequestTracker::Clock::now());  // still answering
+      d.filed.push_back({packet.command, packet.sequence, d.filedBytes.size(), packet.payload.size()});
+      d.filedBytes.insert(d.filedBytes.end(), packet.payload.begin(), packet.payload.end());
+    }
+    if (n == 0) break;
+  }
+}
+
+void ProtocolHandler::Bus::schedule() {
+  if (!line.comm || !line.comm->isOpen()) return;
+  auto now = RequestTracker::Clock::now();
+  // A silent drop loses the line after one RTO; its retries wait for its next turn
+  if (holder && (!holder->awaitingAnswers() || now > holdUntil)) holder = nullptr;
+  if (!holder) {
+    for (std::size_t i = 0; i < drops.size(); i++) {
+      ProtocolHandler* drop = drops[(nextDrop + i) % drops.size()];
+      if (!drop->hasWork(now)) continue;
+      holder = drop;
+      nextDrop = (nextDrop + i + 1) % drops.size();
+      grantLeft = burst;
+      extendHold(now);
+      counters.grants++;
       break;
     }
+    if (!holder) return;
   }
+  std::size_t sent = holder->transmit(grantLeft);
+  grantLeft -= sent;
+  if (sent > 0) extendHold(now);
+}
+
+void ProtocolHandler::Bus::extendHold(RequestTracker::Clock::time_point now) {
+  holdUntil = now + std::chrono::milliseconds(holder->requests.stats().rtoMs);
 }
@@ -0,0 +1,103 @@
+#include "ReplayPort.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Log.hpp"
+
+bool ReplayPort::open(const std::string& port, int) {
+  close();
+
+  std::string path = port;
+  if (path.rfind(kPrefix, 0) == 0) path = path.substr(std::strlen(kPrefix));
+  if (auto query = path.find("?speed="); query != std::string::npos) {
+    speed = std::max(0.0, std::atof(path.c_str() + query + 7));
+    path.resize(query);
+  }
+
+  if (!reader.open(path)) return false;
+  cursor = reader.begin();
+  // Start the clock at the first record rather than at capture start
+  LinkTrace::Record first;
+  uint64_t peek = cursor;
+  originNs = reader.next(peek, first) ? first.timeNs : 0;
+  current = {};
+  originTime = std::chrono::steady_clock::now();
+  Log::Trace::Info() << "Replaying " << path << ": " << reader.recordCount() << " records, "
+                     << reader.durationNs() / 1'000'000 << " ms at "
+                     << (speed > 0 ? std::to_string(speed) + "x" : std::string("max speed"));
+  return true;
+}
+
+void ReplayPort::close() {
+  reader.close();
+  haveCurrent = false;
+  done = false;
+  currentPos = 0;
+  burst = 0;
+  counters = {};
+}
+
+void ReplayPort::setSpeed(double newSpeed) {
+  // Re-anchor the clock at the current trace position so the change applies from here on
+  auto now = std::chrono::steady_clock::now();
+  if (speed > 0.0) {
+    originNs += static_cast<uint64_t>(std::chrono::duration<double, std::nano>(now - originTime).count() * speed);
+  } else {
+    originNs = current.timeNs;
+  }
+  originTime = now;
+  speed = std::max(0.0, newSpeed);
+}
+
+bool ReplayPort::loadNext() {
+  while (reader.next(cursor, current)) {
+    if (current.direction == LinkTrace::Direction::kRx && !current.data.empty()) {
+      haveCurrent = true;
+      currentPos = 0;
+      counters.records++;
+      return true;
+    }
+  }
+  haveCurrent = false;
+  if (!done) Log::Trace::Info() << "Replay finished (" << counters.bytes << " bytes)";
+  done = true;
+  return false;
+}
+
+bool ReplayPort::isDue(uint64_t timeNs) const {
+  if (speed <= 0.0) return true;
+  if (timeNs <= originNs) return true;
+  auto elapsed = std::chrono::steady_clock::now() - originTime;
+  double traceElapsed = std::chrono::duration<double, std::nano>(elapsed).count() * speed;
+  return static_cast<double>(timeNs - originNs) <= traceElapsed;
+}
+
+std::size_t ReplayPort::read(std::span<uint8_t> buffer) {
+  if (!isOpen()) return 0;
+
+  if (speed <= 0.0 && burst >= kBurstBytes) {
+    burst = 0;
+    return 0;
+  }
+
+  std::size_t copied = 0;
+  while (copied < buffer.size()) {
+    if (!haveCurrent && !loadNext()) break;
+    if (currentPos == 0 && !isDue(current.timeNs)) break;
+
+    std::size_t n = std::min(buffer.size() - copied, current.data.size() - currentPos);
+    std::memcpy(buffer.data() + copied, current.data.data() + currentPos, n);
+    copied += n;
+    currentPos += n;
+    counters.bytes += n;
+    if (currentPos == current.data.size()) haveCurrent = false;
+  }
+
+  burst += copied;
+  return copied;
+}
+
+std::size_t ReplayPort::write(std::span<const uint8_t> data) {
+  counters.droppedTxBytes += data.size();
+  return data.size();
+}
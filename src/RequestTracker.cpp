@@ -0,0 +1,185 @@
+#include "RequestTracker.hpp"
+#include <algorithm>
+#include "Log.hpp"
+
+namespace {
+
+uint32_t microsBetween(RequestTracker::Clock::time_point from, RequestTracker::Clock::time_point to) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+  return static_cast<uint32_t>(std::clamp<int64_t>(us, 1, UINT32_MAX));
+}
+
+}  // namespace
+
+RequestTracker::RequestTracker() { counters.rtoMs = rtoMs; }
+
+void RequestTracker::setWindow(std::size_t requests) { windowSize = std::clamp<std::size_t>(requests, 1, kMaxWindow); }
+
+bool RequestTracker::IsTracked(Protocol::Command cmd) {
+  switch (cmd) {
+    case Protocol::Command::kGetSchema:
+    case Protocol::Command::kGetSchemaPage:
+    case Protocol::Command::kReadAll:
+    case Protocol::Command::kReadChanges:
+    case Protocol::Command::kReadValuePage:
+    case Protocol::Command::kWriteValue:
+    case Protocol::Command::kWriteValueWide:
+    case Protocol::Command::kWriteAll:
+    case Protocol::Command::kSubscribe:
+    case Protocol::Command::kUnsubscribe:
+    case Protocol::Command::kLogFormats:
+    case Protocol::Command::kSetLogLevel:
+    case Protocol::Command::kBlobOpen:
+    case Protocol::Command::kBlobCommit:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool RequestTracker::submit(Protocol::Command cmd, std::span<const uint8_t> payload) {
+  auto slot = std::find_if(slots.begin(), slots.end(), [](const Request& r) { return r.order == 0; });
+  if (slot == slots.end()) {
+    Log::Protocol::Error() << "Too many outstanding requests, dropping command 0x" << std::hex
+                           << static_cast<int>(cmd);
+    return false;
+  }
+  slot->command = cmd;
+  slot->payload.assign(payload.begin(), payload.end());
+  slot->sequence = 0;
+  slot->attempts = 0;
+  slot->order = nextOrder++;
+  counters.issued++;
+  counters.queued++;
+  return true;
+}
+
+const RequestTracker::Request* RequestTracker::nextToSend(Clock::time_point now, bool newRequests) {
+  // Retries first: they are older than anything still queued
+  Request* due = nullptr;
+  for (auto& r : slots) {
+    if (r.order == 0 || r.attempts == 0 || r.attempts >= kMaxAttempts || r.deadline > now) continue;
+    if (!due || r.order < due->order) due = &r;
+  }
+  if (due) {
+    uint32_t backoffMs = std::min<uint32_t>(rtoMs << due->attempts, kMaxRtoMs);
+    due->attempts++;
+    due->deadline = now + std::chrono::milliseconds(backoffMs);
+    counters.retransmits++;
+    Log::Protocol::Warning() << "No answer to command 0x" << std::hex << static_cast<int>(due->command) << std::dec
+                             << " (seq " << static_cast<int>(due->sequence) << "), retry "
+                             << static_cast<int>(due->attempts - 1);
+    return due;
+  }
+
+  if (!newRequests || counters.inFlight >= windowSize) return nullptr;
+  for (auto& r : slots) {
+    if (r.order == 0 || r.attempts != 0) continue;
+    if (!due || r.order < due->order) due = &r;
+  }
+  if (!due) return nullptr;
+  due->sequence = sequenced ? allocateSequence() : 0;
+  due->attempts = 1;
+  due->firstSent = now;
+  due->deadline = now + std::chrono::milliseconds(rtoMs);
+  counters.queued--;
+  counters.inFlight++;
+  return due;
+}
+
+bool RequestTracker::hasDue(Clock::time_point now) const {
+  if (counters.queued > 0 && counters.inFlight < windowSize) return true;
+  return std::any_of(slots.begin(), slots.end(), [&](const Request& r) {
+    return r.order != 0 && r.attempts != 0 && r.attempts < kMaxAttempts && r.deadline <= now;
+  });
+}
+
+bool RequestTracker::expire(Clock::time_point now, Result& result) {
+  for (auto& r : slots) {
+    if (r.order == 0 || r.attempts < kMaxAttempts || r.deadline > now) continue;
+    Log::Protocol::Error() << "Command 0x" << std::hex << static_cast<int>(r.command) << std::dec << " (seq "
+                           << static_cast<int>(r.sequence) << ") failed after " << static_cast<int>(r.attempts)
+                           << " attempts";
+    counters.failed++;
+    release(r, result, 0);
+    return true;
+  }
+  return false;
+}
+
+RequestTracker::Match RequestTracker::settle(Protocol::Command cmd, uint8_t sequence,
+                                             std::span<const uint8_t> payload, Clock::time_point now,
+                                             Result& result) {
+  if (!IsTracked(cmd)) return Match::kUnrelated;
+  Request* request = findAnswered(cmd, sequence, payload);
+  if (!request) {
+    if (!sequenced || sequence == 0) return Match::kUnrelated;
+    counters.stale++;
+    return Match::kStale;
+  }
+
+  uint32_t rttUs = microsBetween(request->firstSent, now);
+  if (request->attempts == 1) sampleRtt(rttUs);  // a retried request's RTT is ambiguous
+  counters.completed++;
+  release(*request, result, rttUs);
+  return Match::kSettled;
+}
+
+void RequestTracker::clear() {
+  for (auto& r : slots) r.order = 0;
+  counters.inFlight = 0;
+  counters.queued = 0;
+}
+
+RequestTracker::Request* RequestTracker::findAnswered(Protocol::Command cmd, uint8_t sequence,
+                                                      std::span<const uint8_t> payload) {
+  Request* oldest = nullptr;
+  for (auto& r : slots) {
+    if (r.order == 0 || r.attempts == 0 || r.command != cmd) continue;
+    if (sequenced && sequence != 0) {
+      if (r.sequence == sequence) return &r;
+      continue;
+    }
+    // Unnumbered answer: a write ACK names its parameter, anything else answers the oldest
+    std::size_t idSize = cmd == Protocol::Command::kWriteValue       ? 1
+                         : cmd == Protocol::Command::kWriteValueWide ? 2
+                                                                     : 0;
+    if (idSize && (payload.size() < idSize || r.payload.size() < idSize ||
+                   !std::equal(payload.begin(), payload.begin() + idSize, r.payload.begin()))) {
+      continue;
+    }
+    if (!oldest || r.order < oldest->order) oldest = &r;
+  }
+  return oldest;
+}
+
+uint8_t RequestTracker::allocateSequence() {
+  // 0 means "unnumbered"; ids still in flight are skipped so answers stay unambiguous
+  while (true) {
+    if (++lastSequence == 0) lastSequence = 1;
+    bool used = std::any_of(slots.begin(), slots.end(),
+                            [&](const Request& r) { return r.order != 0 && r.sequence == lastSequence; });
+    if (!used) return lastSequence;
+  }
+}
+
+void RequestTracker::sampleRtt(uint32_t rttUs) {
+  counters.lastRttUs = rttUs;
+  if (counters.srttUs == 0) {
+    counters.srttUs = rttUs;
+    counters.rttvarUs = rttUs / 2;
+  } else {
+    uint32_t delta = counters.srttUs > rttUs ? counters.srttUs - rttUs : rttUs - counters.srttUs;
+    counters.rttvarUs = (3 * counters.rttvarUs + delta) / 4;
+    counters.srttUs = (7 * counters.srttUs + rttUs) / 8;
+  }
+  uint32_t rtoUs = counters.srttUs + std::max<uint32_t>(1000, 4 * counters.rttvarUs);
+  rtoMs = std::clamp<uint32_t>(rtoUs / 1000, kMinRtoMs, kMaxRtoMs);
+  counters.rtoMs = rtoMs;
+}
+
+void RequestTracker::release(Request& request, Result& result, uint32_t rttUs) {
+  result = {request.command, request.sequence, request.payload, request.attempts, rttUs};
+  request.order = 0;
+  counters.inFlight--;
+}
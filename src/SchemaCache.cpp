@@ -0,0 +1,100 @@
+#include "SchemaCache.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+#include "Log.hpp"
+#include "Protocol.hpp"
+
+namespace {
+
+bool writeAll(int fd, const uint8_t* data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+}  // namespace
+
+// --- Entry ---
+
+std::span<const uint8_t> SchemaCache::Entry::payload() const {
+  if (!file.isOpen()) return {};
+  return file.bytes().subspan(sizeof(FileHeader));
+}
+
+// --- SchemaCache ---
+
+std::string SchemaCache::DefaultDirectory() {
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::string(xdg) + "/zonaianvil/schemas";
+  if (const char* home = std::getenv("HOME"); home && *home) return std::string(home) + "/.cache/zonaianvil/schemas";
+  return {};
+}
+
+SchemaCache::SchemaCache(std::string directory) : dir(std::move(directory)) {}
+
+std::string SchemaCache::pathFor(uint64_t hash) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "/%016llx.schema", static_cast<unsigned long long>(hash));
+  return dir + name;
+}
+
+SchemaCache::Entry SchemaCache::find(uint64_t hash) const {
+  Entry entry;
+  if (dir.empty() || hash == 0) return entry;
+  std::string path = pathFor(hash);
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) return entry;  // not cached yet
+  if (!entry.file.open(path)) return entry;
+
+  std::span<const uint8_t> bytes = entry.file.bytes();
+  FileHeader header;
+  if (bytes.size() >= sizeof(header)) std::memcpy(&header, bytes.data(), sizeof(header));
+  if (bytes.size() < sizeof(header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.hash != hash || header.length != bytes.size() - sizeof(FileHeader) ||
+      Protocol::HashSchema(entry.payload()) != hash) {
+    Log::App::Warning() << "Ignoring damaged schema cache file " << path;
+    entry.file.close();
+  }
+  return entry;
+}
+
+bool SchemaCache::store(uint64_t hash, std::span<const uint8_t> payload) const {
+  if (dir.empty() || hash == 0) return false;
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+
+  std::string path = pathFor(hash);
+  std::string temp = path + ".tmp" + std::to_string(::getpid());
+  int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    Log::App::Warning() << "Cannot create " << temp << ": " << std::strerror(errno);
+    return false;
+  }
+
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.length = static_cast<uint32_t>(payload.size());
+  header.hash = hash;
+  bool ok = writeAll(fd, reinterpret_cast<const uint8_t*>(&header), sizeof(header)) &&
+            writeAll(fd, payload.data(), payload.size());
+  ok = ::close(fd) == 0 && ok;
+  if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+    Log::App::Warning() << "Cannot write " << path << ": " << std::strerror(errno);
+    ::unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
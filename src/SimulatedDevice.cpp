@@ -0,0 +1,496 @@
+#include "SimulatedDevice.hpp"
+#include <algorithm>
+#include <cmath>
+#include "Crc.hpp"
+#include "Log.hpp"
+#include "LogFormats.hpp"
+#include "ProtocolMessages.hpp"
+
+namespace {
+
+namespace Wire = Protocol::Wire;
+
+constexpr uint8_t kToggle = static_cast<uint8_t>(Protocol::ParamType::kToggle);
+constexpr uint8_t kSlider = static_cast<uint8_t>(Protocol::ParamType::kSlider);
+constexpr uint8_t kNumeric = static_cast<uint8_t>(Protocol::ParamType::kNumeric);
+constexpr uint8_t kString = static_cast<uint8_t>(Protocol::ParamType::kString);
+
+// Reachable through the 8-bit commands; the rest only through paged ones
+bool isNarrow(const SimulatedParam& p) { return p.id <= 0xFF; }
+
+// The device's log messages, indexed by format id (LOG_FORMATS)
+enum LogFormat : uint8_t { kStringUpdated, kValueUpdated, kValueHigh, kBatchRejected, kBatchApplied };
+constexpr std::string_view kLogFormats[] = {
+    "String parameter updated: %s",
+    "Value updated: %g",
+    "Warning: Value is high!",
+    "Batch rejected at entry %u, nothing applied",
+    "Batch of %u value(s) applied",
+};
+
+}  // namespace
+
+std::vector<SimulatedParam> SimulatedDevice::preset(const std::string& presetName) {
+  if (presetName == "ttyMock1") {
+    return {{0, kToggle, "Mock1 Power", 1.0f, 0.0f, 1.0f, ""}, {1, kSlider, "Mock1 Level", 50.0f, 0.0f, 100.0f, ""}};
+  }
+  if (presetName == "ttyMock2") {
+    return {{10, kToggle, "Mock2 Turbo", 0.0f, 0.0f, 1.0f, ""},
+            {11, kToggle, "Mock2 LED", 1.0f, 0.0f, 1.0f, ""},
+            {12, kSlider, "Mock2 Speed", 25.0f, 0.0f, 200.0f, ""},
+            {13, kNumeric, "Mock2 Goal", 150.0f, 0.0f, 500.0f, ""}};
+  }
+  if (presetName == "ttyMock3") {
+    return {{20, kToggle, "Tgl 1", 0.0f, 0.0f, 1.0f, ""},         {21, kToggle, "Tgl 2", 1.0f, 0.0f, 1.0f, ""},
+            {22, kSlider, "Sld 1", 10.0f, 0.0f, 100.0f, ""},      {23, kSlider, "Sld 2", 80.0f, 0.0f, 100.0f, ""},
+            {24, kNumeric, "Num 1", 123.0f, 0.0f, 1000.0f, ""},   {25, kNumeric, "Num 2", 456.0f, 0.0f, 1000.0f, ""},
+            {26, kString, "Str 1", 0.0f, 0.0f, 0.0f, "Hello"},    {27, kString, "Str 2", 0.0f, 0.0f, 0.0f, "World"}};
+  }
+  return {};
+}
+
+std::vector<SimulatedParam> SimulatedDevice::generate(std::size_t count) {
+  std::vector<SimulatedParam> generated;
+  generated.reserve(count);
+  for (std::size_t i = 0; i < count; i++) {
+    auto id = static_cast<uint16_t>(i);
+    switch (i % 4) {
+      case 0:
+        generated.push_back({id, kToggle, "Toggle " + std::to_string(i), 0.0f, 0.0f, 1.0f, ""});
+        break;
+      case 1:
+        generated.push_back({id, kSlider, "Slider " + std::to_string(i), 50.0f, 0.0f, 100.0f, ""});
+        break;
+      case 2:
+        generated.push_back({id, kNumeric, "Numeric " + std::to_string(i), 10.0f, 0.0f, 1000.0f, ""});
+        break;
+      default:
+        generated.push_back({id, kString, "String " + std::to_string(i), 0.0f, 0.0f, 0.0f, "Text"});
+        break;
+    }
+  }
+  return generated;
+}
+
+void SimulatedDevice::setParams(std::vector<SimulatedParam> newParams) {
+  params = std::move(newParams);
+  std::vector<uint8_t> schema;
+  appendSchema(schema);
+  schemaHash = Protocol::HashSchema(schema);
+  // Everything counts as changed once, so a read since version 0 returns it all
+  changeVersion = 1;
+  for (auto& p : params) p.version = changeVersion;
+  cancelSubscriptions();  // they point into the old list
+}
+
+void SimulatedDevice::handleCommand(Protocol::Command cmd, std::span<const uint8_t> payload,
+                                    const Responder& respond) {
+  response.clear();
+  switch (cmd) {
+    case Protocol::Command::kPing: {
+      cancelSubscriptions();
+      logTokens = false;
+      minLogLevel = Protocol::kLogInfo;
+      if (capabilities == 0 || payload.size() < 2 || payload[0] != Protocol::kCapabilityVersion) {
+        response = {Protocol::kPingAck};
+        break;
+      }
+      // Older hosts send no extension byte
+      auto hostCaps = static_cast<uint16_t>(payload[1] | (payload.size() >= 3 ? payload[2] << 8 : 0));
+      auto extended = static_cast<uint8_t>(capabilities >> 8);
+      Protocol::LinkConfig config;
+      config.integrity = Protocol::SelectIntegrity(hostCaps, capabilities);
+      config.framing = Protocol::SelectFraming(hostCaps, capabilities);
+      config.sequenced = Protocol::SelectSequenced(hostCaps, capabilities);
+      config.commonCapabilities = hostCaps & capabilities;
+      logTokens = config.supports(Protocol::kCapLogTokens);
+      response = {Protocol::kPingAck, Protocol::kCapabilityVersion, static_cast<uint8_t>(capabilities),
+                  static_cast<uint8_t>(config.integrity)};
+      if (reportSchemaHash || extended) {
+        // The framing byte precedes the hash even without COBS, and the hash the extension byte
+        response.push_back(static_cast<uint8_t>(config.framing));
+        Wire::SchemaHash::append(response, reportSchemaHash ? schemaHash : 0);
+        if (extended) Wire::PingExtension::append(response, extended);
+      } else if (capabilities & Protocol::kCapCobs) {
+        response.push_back(static_cast<uint8_t>(config.framing));
+      }
+      respond(cmd, response);
+      if (onLinkConfig) onLinkConfig(config);
+      return;
+    }
+
+    case Protocol::Command::kGetSchema:
+      appendSchema(response);
+      break;
+
+    case Protocol::Command::kReadAll: {
+      Wire::Count::append(response, 0);
+      for (const auto& p : params) {
+        if (!isNarrow(p)) continue;
+        appendValue(p);
+        if (++response[0] == 0xFF) break;
+      }
+      break;
+    }
+
+    case Protocol::Command::kReadChanges: {
+      std::size_t offset = 0;
+      uint32_t since;
+      if (!(capabilities & Protocol::kCapReadChanges) || !Wire::Version::decode(payload, offset, since)) break;
+      Wire::Version::append(response, changeVersion);
+      std::size_t countAt = response.size();
+      Wire::Count::append(response, 0);
+      for (const auto& p : params) {
+        if (p.version <= since || !isNarrow(p)) continue;
+        appendValue(p);
+        if (++response[countAt] == 0xFF) break;
+      }
+      break;
+    }
+
+    case Protocol::Command::kGetSchemaPage:
+    case Protocol::Command::kReadValuePage:
+      if (capabilities & Protocol::kCapPaged) appendPage(cmd, payload);
+      break;
+
+    case Protocol::Command::kWriteValue: {
+      uint8_t id = payload.empty() ? 0xFF : payload[0];
+      writeValue(id, payload.subspan(payload.empty() ? 0 : 1), respond);
+      response.clear();
+      Wire::ParamId::append(response, id);
+      break;
+    }
+    case Protocol::Command::kWriteValueWide: {
+      std::size_t offset = 0;
+      uint16_t id;
+      if (!(capabilities & Protocol::kCapPaged) || !Wire::WideParamId::decode(payload, offset, id)) break;
+      writeValue(id, payload.subspan(offset), respond);
+      response.clear();
+      Wire::WideParamId::append(response, id);
+      break;
+    }
+    case Protocol::Command::kWriteAll: {
+      if (!(capabilities & Protocol::kCapWriteAll)) break;
+      writeAll(payload, respond);
+      break;
+    }
+
+    case Protocol::Command::kSubscribe: {
+      if (!(capabilities & Protocol::kCapTelemetry) || payload.size() < Wire::SubscribeHeader::kSize) break;
+      subscribe(payload);
+      Wire::Count::append(response, static_cast<uint8_t>(subscriptions.size()));
+      break;
+    }
+
+    case Protocol::Command::kUnsubscribe: {
+      if (!(capabilities & Protocol::kCapTelemetry) || payload.empty()) break;
+      unsubscribe(payload);
+      Wire::Count::append(response, static_cast<uint8_t>(subscriptions.size()));
+      break;
+    }
+
+    case Protocol::Command::kLogFormats:
+      if (!(capabilities & Protocol::kCapLogTokens)) break;
+      Wire::Count::append(response, 0);
+      for (uint8_t id = 0; id < std::size(kLogFormats); id++, response[0]++) {
+        Wire::LogFormatEntry::append(response, id, kLogFormats[id]);
+      }
+      break;
+    case Protocol::Command::kSetLogLevel: {
+      std::size_t offset = 0;
+      if (!(capabilities & Protocol::kCapLogTokens) || !Wire::LogLevel::decode(payload, offset, minLogLevel)) break;
+      Log::Device::Info() << "[" << name << "] Sending logs of level " << (int)minLogLevel << " and up";
+      Wire::LogLevel::append(response, minLogLevel);
+      break;
+    }
+
+    case Protocol::Command::kBlobOpen:
+      if (capabilities & Protocol::kCapBlob) openBlob(payload);
+      break;
+    case Protocol::Command::kBlobChunk:
+      if (capabilities & Protocol::kCapBlob) receiveChunk(payload);
+      break;
+    case Protocol::Command::kBlobCommit:
+      if (capabilities & Protocol::kCapBlob) commitBlob();
+      break;
+
+    default:
+      break;
+  }
+
+  if (!response.empty() || cmd == Protocol::Command::kPing) {
+    respond(cmd, response);
+  }
+}
+
+void SimulatedDevice::appendSchema(std::vector<uint8_t>& out) const {
+  Wire::Count::append(out, 0);
+  for (const auto& p : params) {
+    if (!isNarrow(p)) continue;
+    Wire::SchemaEntry::append(out, static_cast<uint8_t>(p.id), p.type, p.name, p.min, p.max);
+    if (++out[0] == 0xFF) break;
+  }
+}
+
+void SimulatedDevice::appendValue(const SimulatedParam& p) {
+  auto id = static_cast<uint8_t>(p.id);
+  if (p.type == kString) {
+    Wire::StringValue::append(response, id, p.stringValue);
+  } else {
+    Wire::NumericValue::append(response, id, p.value);
+  }
+}
+
+void SimulatedDevice::appendPage(Protocol::Command cmd, std::span<const uint8_t> request) {
+  std::size_t offset = 0;
+  uint16_t first;
+  uint8_t rows;
+  if (!Wire::PageRequest::decode(request, offset, first, rows)) return;
+  bool schema = cmd == Protocol::Command::kGetSchemaPage;
+  if (schema) {
+    Wire::SchemaPageHeader::append(response, static_cast<uint16_t>(params.size()), first);
+  } else {
+    Wire::ValuePageHeader::append(response, first);
+  }
+  std::size_t countAt = response.size();
+  Wire::Count::append(response, 0);
+  for (std::size_t i = first; i < params.size() && response[countAt] < rows; i++) {
+    const auto& p = params[i];
+    std::size_t size = schema ? Wire::WideSchemaEntry::size(p.id, p.type, p.name, p.min, p.max)
+                       : p.type == kString ? Wire::WideStringValue::size(p.id, p.stringValue)
+                                           : Wire::WideNumericValue::kSize;
+    if (response[countAt] > 0 && response.size() + size > kMaxPageBytes) break;  // the host asks for the rest
+    if (schema) {
+      Wire::WideSchemaEntry::append(response, p.id, p.type, p.name, p.min, p.max);
+    } else if (p.type == kString) {
+      Wire::WideStringValue::append(response, p.id, p.stringValue);
+    } else {
+      Wire::WideNumericValue::append(response, p.id, p.value);
+    }
+    response[countAt]++;
+  }
+}
+
+void SimulatedDevice::writeValue(uint16_t id, std::span<const uint8_t> value, const Responder& respond) {
+  auto p = std::find_if(params.begin(), params.end(), [&](const SimulatedParam& param) { return param.id == id; });
+  if (p == params.end()) return;  // unknown ids are acknowledged all the same
+  std::size_t offset = 0;
+  std::string_view text;
+  float newVal;
+  if (p->type == kString && Wire::Str8::load(value, offset, text)) {
+    p->stringValue = text;
+    p->version = ++changeVersion;
+    Log::Device::Info() << "[" << name << "] Param " << id << " updated to \"" << p->stringValue << "\"";
+    sendLog<Wire::Str8>(respond, Protocol::kLogInfo, kStringUpdated, p->stringValue);
+  } else if (p->type != kString && Wire::F32::load(value, offset, newVal)) {
+    p->value = newVal;
+    p->version = ++changeVersion;
+    Log::Device::Info() << "[" << name << "] Param " << id << " updated to " << newVal;
+    sendLog<Wire::F32>(respond, Protocol::kLogInfo, kValueUpdated, newVal);
+    if (newVal > 90.0f) sendLog(respond, Protocol::kLogWarning, kValueHigh);
+  }
+}
+
+void SimulatedDevice::writeAll(std::span<const uint8_t> payload, const Responder& respond) {
+  // Every entry is checked before the first one is applied, so a batch commits whole or not at all
+  std::size_t offset = 0;
+  uint8_t count = 0;
+  Wire::Count::decode(payload, offset, count);
+  staged.clear();
+  while (staged.size() < count && offset < payload.size()) {
+    uint8_t id = payload[offset];
+    auto p = std::find_if(params.begin(), params.end(), [&](const SimulatedParam& param) { return param.id == id; });
+    if (p == params.end()) break;
+    StagedWrite write{static_cast<std::size_t>(p - params.begin()), 0.0f, {}};
+    bool valid = p->type == kString
+                     ? Wire::StringValue::decode(payload, offset, id, write.text)
+                     : Wire::NumericValue::decode(payload, offset, id, write.value) && std::isfinite(write.value) &&
+                           write.value >= p->min && write.value <= p->max;
+    if (!valid) break;
+    staged.push_back(write);
+  }
+
+  auto applied = static_cast<uint8_t>(staged.size());
+  if (applied < count) {
+    Log::Device::Warning() << "[" << name << "] WRITE_ALL rejected at entry " << (int)applied << " of "
+                           << (int)count;
+    sendLog<Wire::U32>(respond, Protocol::kLogWarning, kBatchRejected, applied);
+    Wire::WriteAllAck::append(response, static_cast<uint8_t>(Wire::WriteAllStatus::kRejected), count, applied);
+    return;
+  }
+  for (const auto& write : staged) {
+    SimulatedParam& p = params[write.index];
+    if (p.type == kString) {
+      p.stringValue = write.text;
+    } else {
+      p.value = write.value;
+    }
+    p.version = ++changeVersion;
+  }
+  Log::Device::Info() << "[" << name << "] WRITE_ALL applied " << (int)count << " value(s)";
+  sendLog<Wire::U32>(respond, Protocol::kLogInfo, kBatchApplied, count);
+  Wire::WriteAllAck::append(response, static_cast<uint8_t>(Wire::WriteAllStatus::kCommitted), count, count);
+}
+
+void SimulatedDevice::subscribe(std::span<const uint8_t> payload) {
+  // Wire::SubscribeHeader then the ids; string parameters have no sample to push and are skipped
+  std::size_t offset = 0;
+  uint32_t periodUs;
+  uint8_t declared;
+  if (!Wire::SubscribeHeader::decode(payload, offset, periodUs, declared)) return;
+  periodUs = std::max(periodUs, kMinPeriodUs);
+  std::size_t count = std::min<std::size_t>(declared, payload.size() - offset);
+  auto now = Clock::now();
+  for (uint8_t id : payload.subspan(offset, count)) {
+    auto param = std::find_if(params.begin(), params.end(), [&](const SimulatedParam& p) { return p.id == id; });
+    if (param == params.end() || param->type == kString) continue;
+    std::size_t index = static_cast<std::size_t>(param - params.begin());
+    auto sub = std::find_if(subscriptions.begin(), subscriptions.end(),
+                            [&](const Subscription& s) { return s.index == index; });
+    if (sub == subscriptions.end()) sub = subscriptions.insert(subscriptions.end(), {index, 0, now});
+    sub->periodUs = periodUs;
+  }
+  Log::Device::Info() << "[" << name << "] " << subscriptions.size() << " channel(s) subscribed, period "
+                      << periodUs << " us";
+}
+
+void SimulatedDevice::unsubscribe(std::span<const uint8_t> payload) {
+  // Wire::Count then the ids; a count of 0 cancels everything
+  std::size_t offset = 0;
+  uint8_t declared;
+  if (!Wire::Count::decode(payload, offset, declared)) return;
+  std::size_t count = std::min<std::size_t>(declared, payload.size() - offset);
+  if (count == 0) {
+    subscriptions.clear();
+  } else {
+    for (uint8_t id : payload.subspan(offset, count)) {
+      std::erase_if(subscriptions, [&](const Subscription& s) { return params[s.index].id == id; });
+    }
+  }
+  Log::Device::Info() << "[" << name << "] " << subscriptions.size() << " channel(s) still subscribed";
+}
+
+void SimulatedDevice::poll(Clock::time_point now, const Responder& respond) {
+  for (auto& sub : subscriptions) {
+    if (now - sub.next > kMaxLag) sub.next = now;  // the host stalled us; drop what it could not take anyway
+  }
+  // Samples go out in time order across channels; each channel's are one period apart
+  while (true) {
+    auto due = std::min_element(subscriptions.begin(), subscriptions.end(),
+                                [](const Subscription& a, const Subscription& b) { return a.next < b.next; });
+    if (due == subscriptions.end() || due->next > now) break;
+    constexpr std::size_t kCountAt = Wire::TelemetryHeader::kSize;
+    if (telemetry.empty()) {
+      auto timeUs = static_cast<uint32_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(due->next - epoch).count());
+      Wire::TelemetryHeader::append(telemetry, timeUs);
+      Wire::Count::append(telemetry, 0);
+      batchStart = due->next;
+    }
+    const SimulatedParam& p = params[due->index];
+    Wire::NumericValue::append(telemetry, static_cast<uint8_t>(p.id), p.value);  // subscribed by 8-bit id
+    due->next += std::chrono::microseconds(due->periodUs);
+    if (++telemetry[kCountAt] == kMaxBatchSamples) flushTelemetry(respond);
+  }
+  if (!telemetry.empty() && now - batchStart >= kBatchInterval) flushTelemetry(respond);
+}
+
+SimulatedDevice::Clock::time_point SimulatedDevice::nextDeadline() const {
+  // Samples are only observable once their batch goes out, so a started batch waits for its deadline
+  if (!telemetry.empty()) return batchStart + kBatchInterval;
+  auto deadline = Clock::time_point::max();
+  for (const auto& sub : subscriptions) deadline = std::min(deadline, sub.next);
+  return deadline;
+}
+
+void SimulatedDevice::cancelSubscriptions() {
+  subscriptions.clear();
+  telemetry.clear();
+}
+
+void SimulatedDevice::flushTelemetry(const Responder& respond) {
+  respond(Protocol::Command::kTelemetry, telemetry);
+  telemetry.clear();
+}
+
+void SimulatedDevice::openBlob(std::span<const uint8_t> payload) {
+  std::size_t offset = 0;
+  uint8_t slot;
+  uint32_t size, crc;
+  if (!Wire::BlobOpen::decode(payload, offset, slot, size, crc)) return;
+  auto status = Wire::BlobStatus::kOk;
+  if (slot >= kBlobSlots) {
+    status = Wire::BlobStatus::kBadSlot;
+  } else if (size > kMaxBlobBytes) {
+    status = Wire::BlobStatus::kTooLarge;
+  } else if (blob.open && blob.slot == slot && blob.size == size && blob.crc == crc) {
+    Log::Device::Info() << "[" << name << "] Blob for slot " << (int)slot << " resumes at " << blob.data.size()
+                        << " of " << size << " bytes";
+  } else {
+    // A different blob, or none yet: start over
+    blob = {true, false, slot, size, crc, 0, {}};
+    blob.data.reserve(size);
+  }
+  uint32_t resumeAt = status == Wire::BlobStatus::kOk ? static_cast<uint32_t>(blob.data.size()) : 0;
+  Wire::BlobOpenAck::append(response, static_cast<uint8_t>(status), resumeAt, kBlobChunkBytes, kBlobWindowChunks);
+}
+
+void SimulatedDevice::receiveChunk(std::span<const uint8_t> payload) {
+  std::size_t offset = 0;
+  uint32_t at;
+  if (!blob.open || !Wire::BlobChunkHeader::decode(payload, offset, at)) return;
+  // Only bytes that continue the data are kept (a resent chunk may overlap it). A
+  // chunk further on means one went missing: it is dropped and the repeated
+  // acknowledgement tells the host where to resume.
+  auto bytes = payload.subspan(offset);
+  std::size_t have = blob.data.size();
+  if (at <= have && at + bytes.size() > have) {
+    auto fresh = bytes.subspan(have - at);
+    fresh = fresh.first(std::min<std::size_t>(fresh.size(), blob.size - have));
+    blob.data.insert(blob.data.end(), fresh.begin(), fresh.end());
+    blob.crcSoFar = Crc::Crc32c(fresh, blob.crcSoFar);
+  }
+  Wire::BlobChunkAck::append(response, static_cast<uint32_t>(blob.data.size()));
+}
+
+void SimulatedDevice::commitBlob() {
+  auto status = Wire::BlobStatus::kOk;
+  if (!blob.open) {
+    if (!blob.committed) status = Wire::BlobStatus::kNoTransfer;
+  } else if (blob.data.size() < blob.size) {
+    status = Wire::BlobStatus::kIncomplete;
+  } else if (blob.crcSoFar != blob.crc) {
+    status = Wire::BlobStatus::kBadCrc;
+    Log::Device::Warning() << "[" << name << "] Blob for slot " << (int)blob.slot << " fails its CRC; discarded";
+    blob = {};
+  } else {
+    Log::Device::Info() << "[" << name << "] Blob of " << blob.size << " bytes committed to slot " << (int)blob.slot;
+    if (onBlob) onBlob(blob.slot, blob.data);
+    blob = {};
+    blob.committed = true;
+  }
+  Wire::BlobCommitAck::append(response, static_cast<uint8_t>(status));
+}
+
+template <typename... Fields>
+void SimulatedDevice::sendLog(const Responder& respond, uint8_t level, uint8_t format,
+                              const typename Fields::Type&... args) {
+  if (level < minLogLevel) return;
+  logArgs.clear();
+  if constexpr (sizeof...(Fields) > 0) Wire::Message<Fields...>::append(logArgs, args...);
+  emitLog(respond, level, format);
+}
+
+void SimulatedDevice::emitLog(const Responder& respond, uint8_t level, uint8_t format) {
+  logPacket.clear();
+  if (logTokens) {
+    Wire::LogTokenHeader::append(logPacket, level, format);
+    logPacket.insert(logPacket.end(), logArgs.begin(), logArgs.end());
+    respond(Protocol::Command::kLogToken, logPacket);
+    return;
+  }
+  std::string text = Protocol::FormatLog(kLogFormats[format], logArgs);
+  logPacket.push_back(level);
+  logPacket.insert(logPacket.end(), text.begin(), text.end());
+  respond(Protocol::Command::kLog, logPacket);
+}
@@ -0,0 +1,159 @@
+#include "SocketPort.hpp"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "Log.hpp"
+
+bool SocketPort::isSocketUri(const std::string& port) {
+  return port.rfind(kUnixPrefix, 0) == 0 || port.rfind(kTcpPrefix, 0) == 0;
+}
+
+SocketPort::SocketPort(IoLoop* sharedLoop) : sharedLoop(sharedLoop) {}
+
+SocketPort::~SocketPort() { close(); }
+
+bool SocketPort::open(const std::string& port, int) {
+  if (isOpen()) close();
+
+  if (port.rfind(kUnixPrefix, 0) == 0) {
+    fd = connectUnix(port.substr(std::strlen(kUnixPrefix)));
+  } else if (port.rfind(kTcpPrefix, 0) == 0) {
+    fd = connectTcp(port.substr(std::strlen(kTcpPrefix)));
+  } else {
+    Log::Serial::Error() << "Not a socket URI: " << port;
+    return false;
+  }
+  if (fd < 0) return false;
+
+  if (!sharedLoop) ownLoop = std::make_unique<IoLoop>();
+  ioLoop = sharedLoop ? sharedLoop : ownLoop.get();
+  if (!ioLoop->attach(channel, fd)) {
+    close();
+    return false;
+  }
+
+  Log::Serial::Info() << "Connected to " << port;
+  return true;
+}
+
+void SocketPort::close() {
+  if (ioLoop) {
+    ioLoop->detach(channel);
+    ioLoop = nullptr;
+    ownLoop.reset();
+  }
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool SocketPort::isOpen() const { return fd >= 0 && !channel.hasFailed(); }
+
+std::size_t SocketPort::read(std::span<uint8_t> buffer) {
+  if (!isOpen()) return 0;
+  return channel.read(buffer);
+}
+
+std::size_t SocketPort::write(std::span<const uint8_t> data) {
+  if (!isOpen()) return 0;
+  return channel.write(data);
+}
+
+std::size_t SocketPort::writev(std::span<const std::span<const uint8_t>> chunks) {
+  if (!isOpen()) return 0;
+  return channel.writev(chunks);
+}
+
+int SocketPort::connectUnix(const std::string& path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+    Log::Serial::Error() << "Invalid Unix socket path: " << path;
+    return -1;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (s < 0) {
+    Log::Serial::Error() << "socket(AF_UNIX) failed: " << std::strerror(errno);
+    return -1;
+  }
+  // Local connects complete immediately or fail (EAGAIN: listener backlog full)
+  if (::connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    Log::Serial::Error() << "Cannot connect to " << path << ": " << std::strerror(errno);
+    ::close(s);
+    return -1;
+  }
+  return s;
+}
+
+int SocketPort::connectTcp(const std::string& hostPort) {
+  // "host:port" or "[v6addr]:port"
+  std::size_t colon = hostPort.rfind(':');
+  if (colon == std::string::npos || colon + 1 == hostPort.size()) {
+    Log::Serial::Error() << "Expected tcp:<host>:<port>, got " << hostPort;
+    return -1;
+  }
+  std::string host = hostPort.substr(0, colon);
+  std::string service = hostPort.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* results = nullptr;
+  if (int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &results); rc != 0) {
+    Log::Serial::Error() << "Cannot resolve " << hostPort << ": " << gai_strerror(rc);
+    return -1;
+  }
+
+  int s = -1;
+  int lastError = 0;
+  for (addrinfo* ai = results; ai && s < 0; ai = ai->ai_next) {
+    s = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+    if (s < 0) {
+      lastError = errno;
+      continue;
+    }
+    if (::connect(s, ai->ai_addr, ai->ai_addrlen) != 0 && (errno != EINPROGRESS || !waitConnected(s))) {
+      lastError = errno;
+      ::close(s);
+      s = -1;
+    }
+  }
+  freeaddrinfo(results);
+
+  if (s < 0) {
+    Log::Serial::Error() << "Cannot connect to " << hostPort << ": " << std::strerror(lastError);
+    return -1;
+  }
+
+  // Packets are small and latency-bound; never hold them back for coalescing
+  // (TxQueue already batches a whole frame into one write)
+  int one = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return s;
+}
+
+bool SocketPort::waitConnected(int fd) {
+  pollfd pfd{fd, POLLOUT, 0};
+  int ready;
+  do {
+    ready = ::poll(&pfd, 1, kConnectTimeoutMs);
+  } while (ready < 0 && errno == EINTR);
+  if (ready == 0) errno = ETIMEDOUT;
+  if (ready <= 0) return false;
+
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) return false;
+  errno = error;
+  return error == 0;
+}
@@ -0,0 +1,132 @@
+#include "TxQueue.hpp"
+#include <algorithm>
+#include <cstring>
+#include "Log.hpp"
+
+TxQueue::TxQueue(ICommunication* comm, std::size_t flushThreshold)
+    : comm(comm), threshold(std::min(flushThreshold, kCapacity)), buffer(kCapacity) {}
+
+std::size_t TxQueue::frameBound(std::size_t length) const {
+  if (link.framing == Protocol::Framing::kCobs) return Cobs::MaxFrameSize(length + kOverhead);
+  return length + kOverhead;
+}
+
+std::size_t TxQueue::writeHeader(uint8_t* out, Protocol::Command cmd, std::size_t length, uint8_t sequence,
+                                 uint8_t address) const {
+  Protocol::PacketHeader header;
+  header.startByte = Protocol::kStartByte;
+  header.command = static_cast<uint8_t>(cmd);
+  header.length = static_cast<uint16_t>(length);
+  std::memcpy(out, &header, sizeof(header));
+  if (link.addressed) out[sizeof(header)] = address;
+  if (link.sequenced) out[link.headerSize() - 1] = sequence;
+  return link.headerSize();
+}
+
+std::span<uint8_t> TxQueue::beginPacket(Protocol::Command cmd, std::size_t length, uint8_t sequence,
+                                        uint8_t address) {
+  std::size_t bound = frameBound(length);
+  if (bound > kCapacity) return {};
+  if (used + bound > kCapacity) flush();
+  if (used + bound > kCapacity) {
+    Log::Protocol::Error() << "TX queue full, dropping command 0x" << std::hex << static_cast<int>(cmd);
+    return {};
+  }
+
+  // Leave room in front for the COBS encoder to write over the raw packet
+  packetStart = used;
+  if (link.framing == Protocol::Framing::kCobs) packetStart += Cobs::MaxOverhead(length + kOverhead);
+  std::size_t headerSize = writeHeader(&buffer[packetStart], cmd, length, sequence, address);
+  packetLength = length;
+  packetOpen = true;
+  return {&buffer[packetStart + headerSize], length};
+}
+
+void TxQueue::commitPacket() {
+  if (!packetOpen) return;
+  packetOpen = false;
+
+  std::size_t payloadStart = packetStart + link.headerSize();
+  std::span<const uint8_t> header(&buffer[packetStart], link.headerSize());
+  std::span<const uint8_t> payload(&buffer[payloadStart], packetLength);
+  uint32_t trailer = Protocol::ComputeTrailer(link.integrity, header, payload);
+  Protocol::StoreTrailer(link, trailer, &buffer[payloadStart + packetLength]);
+  std::size_t packetEnd = payloadStart + packetLength + link.trailerSize();
+  if (link.framing == Protocol::Framing::kCobs) {
+    Cobs::Encoder encoder(&buffer[used]);
+    encoder.put({&buffer[packetStart], packetEnd - packetStart});
+    used += encoder.finish();
+  } else {
+    used = packetEnd;
+  }
+  queuedPackets++;
+
+  if (used >= threshold) flush();
+}
+
+void TxQueue::enqueue(Protocol::Command cmd, std::span<const uint8_t> payload, uint8_t sequence, uint8_t address) {
+  if (frameBound(payload.size()) <= kCapacity) {
+    std::span<uint8_t> dst = beginPacket(cmd, payload.size(), sequence, address);
+    if (!packetOpen) return;
+    if (!payload.empty()) std::memcpy(dst.data(), payload.data(), payload.size());
+    commitPacket();
+    return;
+  }
+
+  // Too large for the buffer: flush first to keep ordering, then gather-write it
+  // (or, in COBS framing, encode it into the scratch frame and write that)
+  flush();
+  if (used > 0) {
+    Log::Protocol::Error() << "TX queue backed up, dropping command 0x" << std::hex << static_cast<int>(cmd);
+    return;
+  }
+  uint8_t header[Protocol::kMaxHeaderSize];
+  std::span<const uint8_t> headerBytes(header, writeHeader(header, cmd, payload.size(), sequence, address));
+  uint8_t trailer[Protocol::kMaxTrailerSize];
+  Protocol::StoreTrailer(link, Protocol::ComputeTrailer(link.integrity, headerBytes, payload), trailer);
+  const std::span<const uint8_t> chunks[] = {headerBytes, payload, {trailer, link.trailerSize()}};
+  std::size_t written = 0;
+  if (link.framing == Protocol::Framing::kCobs) {
+    scratch.resize(std::max(scratch.size(), frameBound(payload.size())));
+    Cobs::Encoder encoder(scratch.data());
+    for (auto chunk : chunks) encoder.put(chunk);
+    const std::span<const uint8_t> frame[] = {{scratch.data(), encoder.finish()}};
+    written = comm->writev(frame);
+  } else {
+    written = comm->writev(chunks);
+  }
+  if (written == 0) {
+    Log::Protocol::Error() << "Transport not accepting writes, dropping command 0x" << std::hex
+                           << static_cast<int>(cmd) << std::dec << " (" << payload.size() << " bytes)";
+    return;
+  }
+  counters.packets++;
+  counters.bytes += written;
+  counters.flushes++;
+  counters.lastFlushPackets = 1;
+  counters.lastFlushBytes = static_cast<uint32_t>(written);
+}
+
+void TxQueue::flush() {
+  if (used == 0 || !comm) return;
+
+  std::size_t written = comm->write(std::span<const uint8_t>(buffer.data(), used));
+  if (written < used) {
+    // Transport is backed up: keep the unsent tail so the byte stream stays intact
+    std::memmove(buffer.data(), buffer.data() + written, used - written);
+    Log::Protocol::Debug() << "TX backpressure, " << (used - written) << " bytes deferred";
+  }
+  used -= written;
+  if (written == 0) return;
+
+  counters.flushes++;
+  counters.bytes += written;
+  counters.lastFlushBytes = static_cast<uint32_t>(written);
+  if (used == 0) {
+    counters.packets += queuedPackets;
+    counters.lastFlushPackets = queuedPackets;
+    queuedPackets = 0;
+  } else {
+    counters.lastFlushPackets = 0;
+  }
+}
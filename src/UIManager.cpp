@@ -1,4 +1,5 @@
 #include "UIManager.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
@@ -63,7 +64,7 @@ void ApplyFont(Font font, int fontSize) {
   GuiSetStyle(DEFAULT, TEXT_SIZE, fontSize);
 }
 
-void UpdateStateLogic(AppUIContext& ctx, AppSM& sm) {
+void UpdateStateLogic(AppUIContext& ctx, AppSM& sm, CommunicationManager::Manager& comms) {
   using namespace boost::sml::literals;
 
   if (sm.is("Welcome"_s)) {
@@ -74,9 +75,12 @@ void UpdateStateLogic(AppUIContext& ctx, AppSM& sm) {
     return;
   }
 
-  if (ctx.pendingSchemaResponse && (GetTime() - ctx.stateTransitionTime) > (kTransitionDelayMs / 1000.0)) {
-    sm.process_event(SchemaReceivedEvent{});
-    ctx.pendingSchemaResponse = false;
+  for (const auto& session : comms.getSessions()) {
+    if (session->pendingSchemaResponse &&
+        (GetTime() - session->stateTransitionTime) > (kTransitionDelayMs / 1000.0)) {
+      session->sm.process_event(SchemaReceivedEvent{});
+      session->pendingSchemaResponse = false;
+    }
   }
 }
 
@@ -90,8 +94,8 @@ void HandleInput(AppUIContext& ctx) {
       conn.currentPort = (conn.currentPort - 1 + (int)conn.portPaths.size()) % (int)conn.portPaths.size();
     if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER)) conn.portDropdownEdit = false;
   } else if (conn.baudDropdownEdit) {
-    if (IsKeyPressed(KEY_DOWN)) conn.baudRateIndex = (conn.baudRateIndex + 1) % 5;
-    if (IsKeyPressed(KEY_UP)) conn.baudRateIndex = (conn.baudRateIndex - 1 + 5) % 5;
+    if (IsKeyPressed(KEY_DOWN)) conn.baudRateIndex = (conn.baudRateIndex + 1) % conn.kBaudRateCount;
+    if (IsKeyPressed(KEY_UP)) conn.baudRateIndex = (conn.baudRateIndex - 1 + conn.kBaudRateCount) % conn.kBaudRateCount;
     if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER)) conn.baudDropdownEdit = false;
   } else if (visual.themeDropdownEdit) {
     if (IsKeyPressed(KEY_DOWN)) {
@@ -114,6 +118,24 @@ void HandleInput(AppUIContext& ctx) {
   }
 }
 
+void UpdatePortList(AppUIContext& ctx, const std::vector<std::string>& ports) {
+  auto& conn = ctx.connection;
+  std::string selected = conn.currentPort < (int)conn.portPaths.size() ? conn.portPaths[conn.currentPort] : "";
+
+  conn.portPaths = ports;
+  conn.currentPort = 0;
+  conn.portList[0] = '\0';
+  std::size_t used = 0;
+  for (size_t i = 0; i < ports.size(); ++i) {
+    if (ports[i] == selected) conn.currentPort = (int)i;
+    std::size_t len = ports[i].size() + (i > 0 ? 1 : 0);
+    if (used + len >= sizeof(conn.portList)) break;
+    if (i > 0) conn.portList[used++] = ';';
+    std::memcpy(conn.portList + used, ports[i].c_str(), ports[i].size() + 1);
+    used += ports[i].size();
+  }
+}
+
 static void DrawWelcomeScreen(AppUIContext& ctx) {
   const char* title = "ZonaiAnvil";
   float fontSize = 60.0f;
@@ -134,7 +156,7 @@ static void DrawWelcomeScreen(AppUIContext& ctx) {
              subFontSize, spacing, GetColor(GuiGetStyle(DEFAULT, TEXT_COLOR_NORMAL)));
 }
 
-static void DrawSidebar(AppUIContext& ctx, AppSM& sm, CommunicationManager::Manager& comms) {
+static void DrawSidebar(AppUIContext& ctx, CommunicationManager::Manager& comms) {
   using namespace boost::sml::literals;
   auto& conn = ctx.connection;
   auto& visual = ctx.visual;
@@ -143,33 +165,24 @@ static void DrawSidebar(AppUIContext& ctx, AppSM& sm, CommunicationManager::Mana
   float screenHeight = (float)GetScreenHeight();
   GuiGroupBox((Rectangle){10, 10, 200, screenHeight - 20}, "Settings");
 
-  // 1. Static Button (Connect/Disconnect)
-  if (sm.is("Disconnected"_s)) {
+  // 1. Static Button (Connect/Disconnect the selected port)
+  std::string selectedPort = conn.currentPort < (int)conn.portPaths.size() ? conn.portPaths[conn.currentPort] : "";
+  CommunicationManager::Session* selectedSession = comms.findSession(selectedPort);
+  if (!selectedSession) {
     if (GuiButton((Rectangle){20, 210, 180, 40}, "Connect")) {
-      if (conn.currentPort < (int)conn.portPaths.size()) {
-        std::string selectedPort = conn.portPaths[conn.currentPort];
-        int baud = 9600;
-        switch (conn.baudRateIndex) {
-          case 1: baud = 19200; break;
-          case 2: baud = 38400; break;
-          case 3: baud = 57600; break;
-          case 4: baud = 115200; break;
-        }
-        comms.connect(selectedPort, baud);
-      }
+      if (!selectedPort.empty()) comms.connect(selectedPort, conn.selectedBaudRate(), conn.lowLatency);
     }
   } else {
     if (GuiButton((Rectangle){20, 210, 180, 40}, "Disconnect")) {
-      comms.disconnect();
-      ctx.device.config.clear();
-      ctx.device.deviceLogs.clear();
+      comms.disconnect(selectedSession->id);
     }
   }
 
+  CommunicationManager::Session* active = comms.getActiveSession();
   const char* statusStr = "STATUS: Disconnected";
-  if (sm.is("Connecting"_s)) statusStr = "STATUS: Connecting...";
-  else if (sm.is("FetchingSchema"_s)) statusStr = "STATUS: Syncing...";
-  else if (sm.is("Connected"_s)) statusStr = "STATUS: Connected";
+  if (active && active->sm.is("Connecting"_s)) statusStr = "STATUS: Connecting...";
+  else if (active && active->sm.is("FetchingSchema"_s)) statusStr = "STATUS: Syncing...";
+  else if (active && active->sm.is("Connected"_s)) statusStr = "STATUS: Connected";
   GuiLabel((Rectangle){20, 255, 180, 20}, statusStr);
 
   // --- Dropdowns drawn BOTTOM-TO-TOP for correct layering ---
@@ -207,15 +220,20 @@ static void DrawSidebar(AppUIContext& ctx, AppSM& sm, CommunicationManager::Mana
   }
   GuiUnlock();
 
-  // 4. Baud Rate (Y=110)
+  // 4. Low latency (Y=150)
+  if (ctx.anyDropdownOpen()) GuiLock();
+  GuiCheckBox((Rectangle){20, 150, 20, 20}, "Low Latency", &conn.lowLatency);
+  GuiUnlock();
+
+  // 5. Baud Rate (Y=110)
   if (ctx.anyDropdownOpen() && !conn.baudDropdownEdit) GuiLock();
   GuiLabel((Rectangle){20, 90, 180, 20}, "Baud Rate:");
-  if (GuiDropdownBox((Rectangle){20, 110, 180, 30}, conn.baudRates, &conn.baudRateIndex, conn.baudDropdownEdit)) {
+  if (GuiDropdownBox((Rectangle){20, 110, 180, 30}, conn.kBaudRates, &conn.baudRateIndex, conn.baudDropdownEdit)) {
     conn.baudDropdownEdit = !conn.baudDropdownEdit;
   }
   GuiUnlock();
 
-  // 5. Serial Port (Top-most Y=50)
+  // 6. Serial Port (Top-most Y=50)
   if (ctx.anyDropdownOpen() && !conn.portDropdownEdit) GuiLock();
   GuiLabel((Rectangle){20, 30, 180, 20}, "Serial Port:");
   if (GuiDropdownBox((Rectangle){20, 50, 180, 30}, conn.portList, &conn.currentPort, conn.portDropdownEdit)) {
@@ -224,9 +242,48 @@ static void DrawSidebar(AppUIContext& ctx, AppSM& sm, CommunicationManager::Mana
   GuiUnlock();
 }
 
-static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* protocol) {
+static float DrawSessionTabs(AppUIContext& ctx, CommunicationManager::Manager& comms, float panelWidth) {
+  const auto& sessions = comms.getSessions();
+  if (sessions.empty()) return 0.0f;
+
+  const float tabWidth = 130.0f;
+  const float tabHeight = 24.0f;
+  const float padding = (float)GuiGetStyle(TOGGLE, GROUP_PADDING);
+  int tabsPerRow = (int)((panelWidth - 20) / (tabWidth + padding));
+  if (tabsPerRow < 1) tabsPerRow = 1;
+
+  std::string tabs;
+  int activeIndex = 0;
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    if (i > 0) tabs += (i % tabsPerRow == 0) ? "\n" : ";";
+    const std::string& port = sessions[i]->port;
+    tabs += port.substr(port.find_last_of('/') + 1);
+    if (sessions[i]->id == ctx.activeSession) activeIndex = (int)i;
+  }
+
+  int selected = activeIndex;
+  if (ctx.anyDropdownOpen()) GuiLock();
+  GuiToggleGroup((Rectangle){230, 35, tabWidth, tabHeight}, tabs.c_str(), &selected);
+  GuiUnlock();
+  if (selected != activeIndex && selected < (int)sessions.size()) ctx.activeSession = sessions[selected]->id;
+
+  int rows = (int)((sessions.size() + tabsPerRow - 1) / tabsPerRow);
+  return rows * (tabHeight + padding) + 5;
+}
+
+// Parameter caption with its write state: "(sending...)" until acknowledged, "*" while staged
+static const char* ParamLabel(const DeviceParameter& param) {
+  if (param.pending) return TextFormat("%s (sending...)", param.name.c_str());
+  if (param.staged) return TextFormat("%s *", param.name.c_str());
+  return param.name.c_str();
+}
+
+static void DrawConfigPanel(AppUIContext& ctx, CommunicationManager::Manager& comms) {
   using namespace boost::sml::literals;
-  auto& device = ctx.device;
+  CommunicationManager::Session* session = comms.getActiveSession();
+  DeviceState idleDevice;
+  auto& device = session ? session->device : idleDevice;
+  ProtocolHandler* protocol = session ? session->protocol.get() : nullptr;
 
   float screenWidth = (float)GetScreenWidth();
   float screenHeight = (float)GetScreenHeight();
@@ -238,8 +295,9 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
                                 ? "Configuration"
                                 : TextFormat("Configuration [%s]", device.connectedDeviceName.c_str());
   GuiGroupBox((Rectangle){220, 10, panelWidth, configPanelHeight}, configTitle);
+  float tabsHeight = DrawSessionTabs(ctx, comms, panelWidth);
 
-  if (sm.is("Connected"_s)) {
+  if (session && session->sm.is("Connected"_s)) {
     float availableWidth = panelWidth - 40;
     float itemWidth = 300.0f;
     float itemHeight = 80.0f;
@@ -249,14 +307,21 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
     int totalRows = device.config.empty() ? 0 : (int)((device.config.size() + itemsPerRow - 1) / itemsPerRow);
     float totalContentHeight = totalRows * itemHeight + 20;
 
-    Rectangle scrollBounds = {230, 40, panelWidth - 20, configPanelHeight - 80};
+    Rectangle scrollBounds = {230, 40 + tabsHeight, panelWidth - 20, configPanelHeight - 80 - tabsHeight};
     Rectangle contentBounds = {0, 0, panelWidth - 40, totalContentHeight};
     Rectangle view = {0, 0, 0, 0};
     GuiScrollPanel(scrollBounds, NULL, contentBounds, &device.configScroll, &view);
 
     BeginScissorMode((int)view.x, (int)view.y, (int)view.width, (int)view.height);
 
-    for (size_t i = 0; i < device.config.size(); ++i) {
+    // Only the rows in view are drawn, and on a paged link only they are fetched
+    int firstRow = std::max(0, (int)((-device.configScroll.y - 10) / itemHeight));
+    int lastRow = (int)((-device.configScroll.y + scrollBounds.height) / itemHeight) + 1;
+    size_t firstItem = std::min(device.config.size(), (size_t)firstRow * itemsPerRow);
+    size_t lastItem = std::min(device.config.size(), (size_t)lastRow * itemsPerRow);
+    comms.loadRows(*session, firstItem, lastItem);
+
+    for (size_t i = firstItem; i < lastItem; ++i) {
       auto& param = device.config[i];
       int row = (int)(i / itemsPerRow);
       int col = (int)(i % itemsPerRow);
@@ -269,31 +334,34 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
 
       if (drawY + itemHeight > scrollBounds.y && drawY < scrollBounds.y + scrollBounds.height) {
         if (param.pending) GuiLock();
-        if (param.type == Protocol::ParamType::kToggle) {
+        if (!param.loaded) {
+          GuiLabel((Rectangle){drawX, drawY, 200, 20}, "Loading...");
+        } else if (param.type == Protocol::ParamType::kToggle) {
           bool val = (param.value > 0.5f);
           bool oldVal = val;
           GuiToggle((Rectangle){drawX, drawY + 20, 150, 30},
-                    param.pending ? TextFormat("%s...", param.name.c_str()) : param.name.c_str(), &val);
+                    param.pending  ? TextFormat("%s...", param.name.c_str())
+                    : param.staged ? TextFormat("%s *", param.name.c_str())
+                                   : param.name.c_str(),
+                    &val);
           if (val != oldVal) {
             param.value = val ? 1.0f : 0.0f;
             param.lastSentValue = param.value;
-            param.pending = true;
-            if (protocol) protocol->writeValue(param.id, param.value);
+            comms.submitEdit(*session, param);
           }
         } else if (param.type == Protocol::ParamType::kSlider) {
           GuiLabel((Rectangle){drawX, drawY, 200, 20},
-                   param.pending ? TextFormat("%s (sending...)", param.name.c_str()) : param.name.c_str());
+                   ParamLabel(param));
           Rectangle sliderRect = {drawX, drawY + 20, 180, 20};
           GuiSlider(sliderRect, TextFormat("%.1f", param.min), TextFormat("%.1f", param.max), &param.value, param.min,
                     param.max);
           if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON) && (std::abs(param.value - param.lastSentValue) > 0.001f)) {
-            param.pending = true;
             param.lastSentValue = param.value;
-            if (protocol) protocol->writeValue(param.id, param.value);
+            comms.submitEdit(*session, param);
           }
         } else if (param.type == Protocol::ParamType::kNumeric) {
           GuiLabel((Rectangle){drawX, drawY, 200, 20},
-                   param.pending ? TextFormat("%s (sending...)", param.name.c_str()) : param.name.c_str());
+                   ParamLabel(param));
           int val = (int)param.value;
           if (GuiValueBox((Rectangle){drawX, drawY + 20, 100, 30}, NULL, &val, (int)param.min, (int)param.max,
                           param.editMode)) {
@@ -301,14 +369,13 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
             if (!param.editMode && (float)val != param.lastSentValue) {
               param.value = (float)val;
               param.lastSentValue = param.value;
-              param.pending = true;
-              if (protocol) protocol->writeValue(param.id, param.value);
+              comms.submitEdit(*session, param);
             }
           }
           if (param.editMode) param.value = (float)val;
         } else if (param.type == Protocol::ParamType::kString) {
           GuiLabel((Rectangle){drawX, drawY, 200, 20},
-                   param.pending ? TextFormat("%s (sending...)", param.name.c_str()) : param.name.c_str());
+                   ParamLabel(param));
           char buffer[128] = {0};
           std::strncpy(buffer, param.stringValue.c_str(), sizeof(buffer) - 1);
           if (GuiTextBox((Rectangle){drawX, drawY + 20, 200, 30}, buffer, 128, param.editMode)) {
@@ -316,8 +383,7 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
             if (!param.editMode && param.stringValue != buffer) {
               param.stringValue = buffer;
               param.lastSentString = param.stringValue;
-              param.pending = true;
-              if (protocol) protocol->writeString(param.id, param.stringValue);
+              comms.submitEdit(*session, param);
             }
           }
           if (param.editMode) param.stringValue = buffer;
@@ -326,14 +392,48 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
       }
     }
     EndScissorMode();
-    if (GuiButton((Rectangle){230, configPanelHeight - 40, 120, 30}, "Refresh All")) {
-      if (protocol) protocol->requestAllValues();
+    if (GuiButton((Rectangle){230, configPanelHeight - 40, 90, 30}, "Refresh All")) {
+      comms.refreshValues(*session);
+    }
+    if (session->capture) {
+      bool recording = session->capture->isRecording();
+      GuiToggle((Rectangle){325, configPanelHeight - 40, 90, 30}, recording ? "Recording" : "Record", &recording);
+      if (recording != session->capture->isRecording()) comms.setRecording(*session, recording);
+    }
+    if (protocol && protocol->getLinkConfig().supports(Protocol::kCapTelemetry)) {
+      bool live = session->telemetryOn;
+      GuiToggle((Rectangle){420, configPanelHeight - 40, 60, 30}, "Live", &live);
+      if (live != session->telemetryOn) comms.setTelemetry(*session, live);
+    }
+    // Batch: edits are staged (marked *) and sent together as one WRITE_ALL transaction by Apply
+    GuiToggle((Rectangle){485, configPanelHeight - 40, 60, 30}, "Batch", &session->stageEdits);
+    auto staged = std::count_if(device.config.begin(), device.config.end(), [](const auto& p) { return p.staged; });
+    if (staged > 0 &&
+        GuiButton((Rectangle){550, configPanelHeight - 40, 90, 30}, TextFormat("Apply (%d)", (int)staged))) {
+      comms.applyStaged(*session);
+    }
+    // A file dropped onto the window is uploaded into the device's first blob slot
+    if (IsFileDropped()) {
+      FilePathList dropped = LoadDroppedFiles();
+      if (dropped.count > 0) comms.sendFile(*session, dropped.paths[0]);
+      UnloadDroppedFiles(dropped);
+    }
+    if (protocol && protocol->isSendingBlob()) {
+      const auto& blob = protocol->blobStats();
+      GuiLabel((Rectangle){650, configPanelHeight - 35, 260, 20},
+               TextFormat("Upload %d%% (%u/%u bytes)", blob.total ? (int)(100.0 * blob.acked / blob.total) : 0,
+                          blob.acked, blob.total));
+    } else if (protocol && protocol->requestStats().srttUs > 0) {
+      const auto& stats = protocol->requestStats();
+      GuiLabel((Rectangle){650, configPanelHeight - 35, 260, 20},
+               TextFormat("RTT %.1f ms, %u in flight, %llu retries", stats.srttUs / 1000.0, stats.inFlight,
+                          (unsigned long long)stats.retransmits));
     }
   } else {
     const char* message = "Please connect to a device";
-    if (sm.is("FetchingSchema"_s))
+    if (session && session->sm.is("FetchingSchema"_s))
       message = "Retrieving device configuration...";
-    else if (sm.is("Connecting"_s))
+    else if (session && session->sm.is("Connecting"_s))
       message = "Establishing connection...";
     int fontSize = GuiGetStyle(DEFAULT, TEXT_SIZE);
     float msgWidth = (float)MeasureText(message, fontSize);
@@ -343,6 +443,14 @@ static void DrawConfigPanel(AppUIContext& ctx, AppSM& sm, ProtocolHandler* proto
   // Device Logs Panel
   float logPanelY = configPanelHeight + 20;
   GuiGroupBox((Rectangle){220, logPanelY, panelWidth, logPanelHeight}, "Device Logs");
+  // Info logs only cross the link when asked for, on devices that can filter them
+  if (protocol && protocol->getLinkConfig().supports(Protocol::kCapLogTokens)) {
+    bool verbose = session->logLevel == Protocol::kLogInfo;
+    GuiToggle((Rectangle){220 + panelWidth - 80, logPanelY - 8, 70, 16}, "Verbose", &verbose);
+    if (verbose != (session->logLevel == Protocol::kLogInfo)) {
+      comms.setLogLevel(*session, verbose ? Protocol::kLogInfo : Protocol::kLogWarning);
+    }
+  }
 
   float logContentHeight = device.deviceLogs.size() * 20.0f + 10.0f;
   Rectangle logScrollBounds = {230, logPanelY + 20, panelWidth - 20, logPanelHeight - 30};
@@ -378,8 +486,8 @@ void Draw(AppUIContext& ctx, AppSM& sm, CommunicationManager::Manager& comms) {
   if (sm.is("Welcome"_s)) {
     DrawWelcomeScreen(ctx);
   } else {
-    DrawConfigPanel(ctx, sm, comms.getProtocol());
-    DrawSidebar(ctx, sm, comms);
+    DrawConfigPanel(ctx, comms);
+    DrawSidebar(ctx, comms);
   }
 }
 